@@ -0,0 +1,113 @@
+#include "audio.hpp"
+
+#include <algorithm>
+
+Beeper::Beeper(float frequency, int16_t volume) : volume(volume) {
+  // Phase is a 32-bit fraction of one period, so one sample advances it by
+  // frequency / sampleRate of 2^32. The top bit picks the half of the wave.
+  phaseStep = static_cast<uint32_t>(frequency * 4294967296.0 /
+                                    AUDIO_SAMPLE_RATE);
+}
+
+bool Beeper::Post(bool on, uint64_t sampleTime) {
+  uint32_t h = head.load(std::memory_order_relaxed);
+
+  if (h - tail.load(std::memory_order_acquire) == QUEUE_SIZE) {
+    return false;
+  }
+
+  events[h & (QUEUE_SIZE - 1)] = {sampleTime, on};
+
+  // Release: the event above must be visible before the new head.
+  head.store(h + 1, std::memory_order_release);
+  return true;
+}
+
+void Beeper::Render(int16_t* out, unsigned int count) {
+  uint64_t now = renderedSamples.load(std::memory_order_relaxed);
+  uint64_t end = now + count;
+  uint32_t t = tail.load(std::memory_order_relaxed);
+  uint32_t h = head.load(std::memory_order_acquire);
+
+  while (now < end) {
+    // Render up to the next event that falls inside this buffer.
+    uint64_t until = end;
+    if (t != h) {
+      Event const& event = events[t & (QUEUE_SIZE - 1)];
+      until = std::clamp(event.sampleTime, now, end);
+
+      if (until == now) {
+        on = event.on;
+        t++;
+        continue;
+      }
+    }
+
+    for (; now < until; now++) {
+      if (on) {
+        *out++ = (phase & 0x80000000u) ? volume : -volume;
+        phase += phaseStep;
+      } else {
+        *out++ = 0;
+      }
+    }
+  }
+
+  // Release: hand the consumed slots back to the producer.
+  tail.store(t, std::memory_order_release);
+  renderedSamples.store(now, std::memory_order_relaxed);
+}
+
+uint64_t Beeper::RenderedSamples() const {
+  return renderedSamples.load(std::memory_order_relaxed);
+}
+
+// ========== WAV file ==========
+
+static void PutU16(std::ofstream& file, uint16_t value) {
+  file.put(static_cast<char>(value & 0xFFu));
+  file.put(static_cast<char>(value >> 8u));
+}
+
+static void PutU32(std::ofstream& file, uint32_t value) {
+  PutU16(file, value & 0xFFFFu);
+  PutU16(file, value >> 16u);
+}
+
+WavSink::WavSink(char const* filename)
+    : file(filename, std::ios::binary) {
+  // RIFF header, the two sizes are patched in the destructor.
+  file.write("RIFF", 4);
+  PutU32(file, 0);
+  file.write("WAVEfmt ", 8);
+  PutU32(file, 16);                     // fmt chunk size
+  PutU16(file, 1);                      // PCM
+  PutU16(file, 1);                      // Mono
+  PutU32(file, AUDIO_SAMPLE_RATE);      // Sample rate
+  PutU32(file, AUDIO_SAMPLE_RATE * 2);  // Bytes per second
+  PutU16(file, 2);                      // Bytes per sample
+  PutU16(file, 16);                     // Bits per sample
+  file.write("data", 4);
+  PutU32(file, 0);
+}
+
+WavSink::~WavSink() {
+  file.seekp(4);
+  PutU32(file, 36 + dataBytes);
+  file.seekp(40);
+  PutU32(file, dataBytes);
+}
+
+void WavSink::Pull(Beeper& beeper, uint64_t sampleTime) {
+  int16_t buffer[1024];
+
+  while (beeper.RenderedSamples() < sampleTime) {
+    unsigned int count = static_cast<unsigned int>(std::min<uint64_t>(
+        sampleTime - beeper.RenderedSamples(), std::size(buffer)));
+    beeper.Render(buffer, count);
+
+    // WAV samples are little-endian, like every host we build for.
+    file.write(reinterpret_cast<char const*>(buffer), count * 2);
+    dataBytes += count * 2;
+  }
+}
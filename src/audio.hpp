@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+
+const unsigned int AUDIO_SAMPLE_RATE = 44100;
+
+// Square wave beeper driven by the sound timer.
+//
+// The emulation thread only reports when the beeper turns on or off, and at
+// which sample ("sampleTime") that happened. Those events go through a
+// single-producer single-consumer ring of atomics, so the audio side never
+// takes a lock or allocates. It can run inside an SDL audio callback.
+//
+// Whoever calls Render() owns the audio clock: sample N of the output is
+// sampleTime N. Events that arrive late are applied at the start of the next
+// buffer instead of being dropped.
+class Beeper {
+ public:
+  explicit Beeper(float frequency = 440.0f, int16_t volume = 3000);
+
+  // Emulation thread. Returns false if the queue is full (the consumer has
+  // stopped pulling), in which case the event is lost.
+  bool Post(bool on, uint64_t sampleTime);
+
+  // Audio thread. Writes the next "count" mono samples.
+  void Render(int16_t* out, unsigned int count);
+
+  // Samples rendered so far, i.e. the sampleTime of the next sample.
+  uint64_t RenderedSamples() const;
+
+ private:
+  struct Event {
+    uint64_t sampleTime;
+    bool on;
+  };
+
+  // Must be a power of 2 so the indices can wrap with a mask.
+  static const uint32_t QUEUE_SIZE = 256;
+  Event events[QUEUE_SIZE]{};
+
+  // head: next slot the producer writes. tail: next slot the consumer reads.
+  // Each is written by one side only.
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+
+  // ========== Audio thread only ==========
+  std::atomic<uint64_t> renderedSamples{0};
+  bool on = false;
+  uint32_t phase = 0;
+  uint32_t phaseStep;
+  int16_t volume;
+};
+
+// Writes what a Beeper renders into a 16-bit mono WAV file.
+// Stands in for a sound device in headless runs.
+class WavSink {
+ public:
+  explicit WavSink(char const* filename);
+
+  // Fixes up the sizes in the header.
+  ~WavSink();
+
+  // Render samples until "sampleTime" is reached.
+  void Pull(Beeper& beeper, uint64_t sampleTime);
+
+ private:
+  std::ofstream file;
+  uint32_t dataBytes = 0;
+};
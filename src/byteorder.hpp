@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Fixed-order integers for the file and wire formats (snapshots, replays,
+// the ROM library, captures and the stream protocol), whatever the host's
+// byte order. Put* append to "out"; Get* read from unaligned memory.
+
+inline void PutU16LE(std::string& out, uint16_t value) {
+  out += static_cast<char>(value & 0xFFu);
+  out += static_cast<char>(value >> 8u);
+}
+
+inline void PutU32LE(std::string& out, uint32_t value) {
+  PutU16LE(out, value & 0xFFFFu);
+  PutU16LE(out, value >> 16u);
+}
+
+inline void PutU64LE(std::string& out, uint64_t value) {
+  PutU32LE(out, value & 0xFFFFFFFFu);
+  PutU32LE(out, value >> 32u);
+}
+
+// PNG is big-endian.
+inline void PutU32BE(std::string& out, uint32_t value) {
+  out += static_cast<char>(value >> 24u);
+  out += static_cast<char>((value >> 16u) & 0xFFu);
+  out += static_cast<char>((value >> 8u) & 0xFFu);
+  out += static_cast<char>(value & 0xFFu);
+}
+
+inline uint16_t GetU16LE(uint8_t const* data) {
+  return data[0] | (data[1] << 8u);
+}
+
+inline uint32_t GetU32LE(uint8_t const* data) {
+  return GetU16LE(data) | (static_cast<uint32_t>(GetU16LE(data + 2)) << 16u);
+}
+
+inline uint64_t GetU64LE(uint8_t const* data) {
+  return GetU32LE(data) | (static_cast<uint64_t>(GetU32LE(data + 4)) << 32u);
+}
+
+// For bytes received into a std::string.
+inline uint16_t GetU16LE(char const* data) {
+  return GetU16LE(reinterpret_cast<uint8_t const*>(data));
+}
+
+inline uint32_t GetU32LE(char const* data) {
+  return GetU32LE(reinterpret_cast<uint8_t const*>(data));
+}
@@ -0,0 +1,388 @@
+#include "capture.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "byteorder.hpp"
+
+const unsigned int CAPTURE_FPS = 60;
+const unsigned int FRAME_PIXELS = PX_WIDTH * PX_HEIGHT;
+
+// ==========================================
+// ========== Small encoding helpers ==========
+// ==========================================
+
+// CRC-32 as used by PNG chunks (polynomial 0xEDB88320, reflected).
+static uint32_t Crc32(char const* data, size_t size) {
+  static uint32_t table[256];
+  static bool tableReady = false;
+
+  if (!tableReady) {
+    for (uint32_t n = 0; n < 256; n++) {
+      uint32_t c = n;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1u) ? 0xEDB88320u ^ (c >> 1u) : c >> 1u;
+      }
+      table[n] = c;
+    }
+    tableReady = true;
+  }
+
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFFu] ^ (crc >> 8u);
+  }
+  return crc ^ 0xFFFFFFFFu;
+}
+
+static uint32_t Adler32(char const* data, size_t size) {
+  uint32_t a = 1, b = 0;
+  for (size_t i = 0; i < size; i++) {
+    a = (a + static_cast<uint8_t>(data[i])) % 65521u;
+    b = (b + a) % 65521u;
+  }
+  return (b << 16u) | a;
+}
+
+static void PutPngChunk(std::string& out, char const* type,
+                        std::string const& data) {
+  PutU32BE(out, data.size());
+  std::string body = std::string(type, 4) + data;
+  out += body;
+  PutU32BE(out, Crc32(body.data(), body.size()));
+}
+
+// GIF image data: LZW codes of variable width, packed LSB first and split
+// into sub-blocks of at most 255 bytes.
+class GifLzw {
+ public:
+  explicit GifLzw(std::string& out) : out(out) {}
+
+  void Encode(uint8_t const* indices, size_t count) {
+    // Minimum code size 2 (the smallest GIF allows), so codes 0-3 are
+    // colours, 4 is CLEAR and 5 is END.
+    out.push_back(MIN_CODE_SIZE);
+    Reset();
+    Emit(CLEAR);
+
+    int prefix = indices[0];
+    for (size_t i = 1; i < count; i++) {
+      int key = prefix * 4 + indices[i];
+      if (children[key] >= 0) {
+        prefix = children[key];
+        continue;
+      }
+
+      Emit(prefix);
+      children[key] = nextCode;
+      if (nextCode >= (1 << width)) {
+        width++;
+      }
+      nextCode++;
+      if (nextCode == 4096) {
+        Emit(CLEAR);
+        Reset();
+      }
+      prefix = indices[i];
+    }
+
+    Emit(prefix);
+    Emit(END);
+    FlushBits();
+    out.push_back(0);  // Block terminator.
+  }
+
+ private:
+  static const int MIN_CODE_SIZE = 2;
+  static const int CLEAR = 4;
+  static const int END = 5;
+
+  void Reset() {
+    std::fill(std::begin(children), std::end(children), -1);
+    nextCode = END + 1;
+    width = MIN_CODE_SIZE + 1;
+  }
+
+  void Emit(int code) {
+    bits |= static_cast<uint32_t>(code) << bitCount;
+    bitCount += width;
+    while (bitCount >= 8) {
+      PutByte(bits & 0xFFu);
+      bits >>= 8u;
+      bitCount -= 8;
+    }
+  }
+
+  void FlushBits() {
+    if (bitCount > 0) {
+      PutByte(bits & 0xFFu);
+    }
+    if (!block.empty()) {
+      out.push_back(static_cast<char>(block.size()));
+      out += block;
+    }
+  }
+
+  void PutByte(uint8_t byte) {
+    block.push_back(static_cast<char>(byte));
+    if (block.size() == 255) {
+      out.push_back(static_cast<char>(255));
+      out += block;
+      block.clear();
+    }
+  }
+
+  std::string& out;
+  std::string block;
+  // children[code * 4 + colour]: code for the string "code + colour".
+  int16_t children[4096 * 4];
+  int nextCode = 0;
+  int width = 0;
+  uint32_t bits = 0;
+  int bitCount = 0;
+};
+
+// =================================
+// ========== Capture ==========
+// =================================
+
+Capture::Capture(CaptureFormat format, std::string const& path,
+                 unsigned int poolSize)
+    : format(format), path(path) {
+  for (unsigned int i = 0; i < poolSize; i++) {
+    pool.push_back(std::make_unique<Frame>());
+    freeFrames.push_back(pool.back().get());
+  }
+
+  // PNG sequences open one file per frame instead.
+  if (format != CaptureFormat::PNG) {
+    file.open(path, std::ios::binary);
+  }
+
+  WriteHeader();
+
+  encoder = std::thread(&Capture::EncoderLoop, this);
+}
+
+Capture::~Capture() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  frameQueued.notify_one();
+  encoder.join();
+
+  WritePending(1);
+  WriteTrailer();
+}
+
+bool Capture::FormatFromPath(std::string const& path, CaptureFormat& format) {
+  auto dot = path.rfind('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+
+  std::string ext = path.substr(dot);
+  if (ext == ".y4m") {
+    format = CaptureFormat::Y4M;
+  } else if (ext == ".png") {
+    format = CaptureFormat::PNG;
+  } else if (ext == ".gif") {
+    format = CaptureFormat::GIF;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void Capture::Submit(uint32_t const* video, double timeMs) {
+  // Skip frames that didn't change; the previous frame simply stays on
+  // screen for longer.
+  if (hasSubmitted &&
+      std::memcmp(video, lastSubmitted, sizeof(lastSubmitted)) == 0) {
+    return;
+  }
+  std::memcpy(lastSubmitted, video, sizeof(lastSubmitted));
+  hasSubmitted = true;
+
+  Frame* frame;
+  {
+    // Backpressure: wait for the encoder to hand a buffer back.
+    std::unique_lock<std::mutex> lock(mutex);
+    frameFreed.wait(lock, [this] { return !freeFrames.empty(); });
+    frame = freeFrames.back();
+    freeFrames.pop_back();
+  }
+
+  std::memcpy(frame->pixels, video, sizeof(frame->pixels));
+  frame->timeMs = timeMs;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push_back(frame);
+  }
+  frameQueued.notify_one();
+}
+
+void Capture::EncoderLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    frameQueued.wait(lock, [this] { return stopping || !queue.empty(); });
+    if (queue.empty()) {
+      // Only reachable when stopping.
+      return;
+    }
+
+    Frame* frame = queue.front();
+    queue.pop_front();
+
+    // Encode without holding the lock so Submit() is never blocked on I/O.
+    lock.unlock();
+    Encode(*frame);
+    lock.lock();
+
+    freeFrames.push_back(frame);
+    frameFreed.notify_one();
+  }
+}
+
+void Capture::Encode(Frame const& frame) {
+  // Place the frame on the 60 fps timeline, always after the previous one.
+  long number = std::lround(frame.timeMs * CAPTURE_FPS / 1000.0);
+  number = std::max(number, pendingNumber + 1);
+
+  WritePending(number - pendingNumber);
+
+  pending = frame;
+  pendingNumber = number;
+}
+
+void Capture::WriteHeader() {
+  std::string out;
+
+  switch (format) {
+    case CaptureFormat::Y4M: {
+      // Full-range 4:2:0. The chroma planes stay grey (128).
+      out = "YUV4MPEG2 W" + std::to_string(PX_WIDTH) + " H" +
+            std::to_string(PX_HEIGHT) + " F" + std::to_string(CAPTURE_FPS) +
+            ":1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n";
+    } break;
+
+    case CaptureFormat::GIF: {
+      out = "GIF89a";
+      PutU16LE(out, PX_WIDTH);
+      PutU16LE(out, PX_HEIGHT);
+      // Global colour table present, 1 bit of colour (2 entries).
+      out.push_back(static_cast<char>(0x80));
+      out.push_back(0);  // Background colour index.
+      out.push_back(0);  // Pixel aspect ratio.
+      out.append("\x00\x00\x00\xFF\xFF\xFF", 6);
+
+      // NETSCAPE2.0 application extension: loop forever.
+      out.append("\x21\xFF\x0B" "NETSCAPE2.0" "\x03\x01\x00\x00\x00", 19);
+    } break;
+
+    case CaptureFormat::PNG:
+      break;
+  }
+
+  file.write(out.data(), out.size());
+}
+
+void Capture::WriteTrailer() {
+  if (format == CaptureFormat::GIF) {
+    file.put(0x3B);
+  }
+}
+
+void Capture::WritePending(long duration) {
+  if (pendingNumber < 0) {
+    return;
+  }
+
+  switch (format) {
+    case CaptureFormat::Y4M: {
+      std::string out = "FRAME\n";
+      for (unsigned int i = 0; i < FRAME_PIXELS; i++) {
+        out.push_back(pending.pixels[i] ? static_cast<char>(0xFF) : 0);
+      }
+      out.append(FRAME_PIXELS / 2, static_cast<char>(128));
+
+      // Y4M is constant frame rate, so hold the frame by repeating it.
+      for (long i = 0; i < duration; i++) {
+        file.write(out.data(), out.size());
+      }
+    } break;
+
+    case CaptureFormat::PNG: {
+      // Raw image data: each row is a filter byte (0 = none) then 8-bit grey.
+      std::string raw;
+      for (unsigned int row = 0; row < PX_HEIGHT; row++) {
+        raw.push_back(0);
+        for (unsigned int col = 0; col < PX_WIDTH; col++) {
+          raw.push_back(pending.pixels[row * PX_WIDTH + col]
+                            ? static_cast<char>(0xFF)
+                            : 0);
+        }
+      }
+
+      // zlib stream with a single uncompressed ("stored") deflate block.
+      // A 64x32 frame is 2 KiB, so compressing isn't worth the code.
+      std::string zlib = "\x78\x01";
+      zlib.push_back(1);  // Final block, stored.
+      PutU16LE(zlib, raw.size());
+      PutU16LE(zlib, ~raw.size() & 0xFFFFu);
+      zlib += raw;
+      PutU32BE(zlib, Adler32(raw.data(), raw.size()));
+
+      std::string header;
+      PutU32BE(header, PX_WIDTH);
+      PutU32BE(header, PX_HEIGHT);
+      header += std::string("\x08\x00\x00\x00\x00", 5);  // 8-bit greyscale.
+
+      std::string out = "\x89PNG\r\n\x1A\n";
+      PutPngChunk(out, "IHDR", header);
+      PutPngChunk(out, "IDAT", zlib);
+      PutPngChunk(out, "IEND", "");
+
+      // "capture.png" becomes "capture_000042.png".
+      char number[16];
+      std::snprintf(number, sizeof(number), "_%06ld", pendingNumber);
+      std::string name = path;
+      name.insert(name.rfind('.'), number);
+
+      std::ofstream png(name, std::ios::binary);
+      png.write(out.data(), out.size());
+    } break;
+
+    case CaptureFormat::GIF: {
+      std::string out;
+
+      // Graphic control extension, delay in 1/100 s.
+      long delay = std::lround(duration * 100.0 / CAPTURE_FPS);
+      delay = std::clamp(delay, 2L, 65535L);
+      out.append("\x21\xF9\x04\x00", 4);
+      PutU16LE(out, delay);
+      out.append("\x00\x00", 2);
+
+      // Image descriptor covering the whole screen.
+      out.push_back(0x2C);
+      PutU16LE(out, 0);
+      PutU16LE(out, 0);
+      PutU16LE(out, PX_WIDTH);
+      PutU16LE(out, PX_HEIGHT);
+      out.push_back(0);
+
+      uint8_t indices[FRAME_PIXELS];
+      for (unsigned int i = 0; i < FRAME_PIXELS; i++) {
+        indices[i] = pending.pixels[i] ? 1 : 0;
+      }
+      GifLzw(out).Encode(indices, FRAME_PIXELS);
+
+      file.write(out.data(), out.size());
+    } break;
+  }
+}
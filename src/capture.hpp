@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+
+enum class CaptureFormat {
+  Y4M,  // Raw YUV4MPEG2 video, 60 fps.
+  PNG,  // One PNG file per frame, numbered on a 60 fps timeline.
+  GIF   // Animated GIF, each frame held for as long as it was on screen.
+};
+
+// Records presented frames without stalling the emulation loop.
+//
+// Submit() is called by the emulation thread each time a frame is presented.
+// If the frame is identical to the previous one it is dropped right away
+// (no copy). Otherwise it is copied into a buffer from a fixed-size pool and
+// queued for a background encoder thread, which converts and writes it.
+//
+// The pool is the backpressure: if the encoder falls behind and every buffer
+// is queued, Submit() waits until one is handed back, so memory use never
+// grows past "poolSize" frames.
+class Capture {
+ public:
+  Capture(CaptureFormat format, std::string const& path,
+          unsigned int poolSize = 8);
+
+  // Drains the queue, finishes the file and joins the encoder thread.
+  ~Capture();
+
+  // Guess the format from a file extension (.y4m, .png, .gif).
+  // Returns false if the extension is not recognised.
+  static bool FormatFromPath(std::string const& path, CaptureFormat& format);
+
+  // "video" is monochrome, 0 or 0xFFFFFFFF per pixel like Chip8::Video().
+  // timeMs: time of this frame, used to place it on the output timeline.
+  void Submit(uint32_t const* video, double timeMs);
+
+ private:
+  struct Frame {
+    uint32_t pixels[PX_WIDTH * PX_HEIGHT];
+    double timeMs;
+  };
+
+  void EncoderLoop();
+  void Encode(Frame const& frame);
+
+  // Write the pending frame, shown for "duration" timeline frames.
+  void WritePending(long duration);
+  void WriteHeader();
+  void WriteTrailer();
+
+  CaptureFormat format;
+  std::string path;
+  std::ofstream file;
+
+  // Owns every frame buffer. Buffers move between freeFrames and queue.
+  std::vector<std::unique_ptr<Frame>> pool;
+  std::vector<Frame*> freeFrames;
+  std::deque<Frame*> queue;
+  bool stopping = false;
+
+  std::mutex mutex;
+  std::condition_variable frameQueued;
+  std::condition_variable frameFreed;
+  std::thread encoder;
+
+  // ========== Emulation thread only ==========
+  uint32_t lastSubmitted[PX_WIDTH * PX_HEIGHT]{};
+  bool hasSubmitted = false;
+
+  // ========== Encoder thread only ==========
+  // Frames are written one behind, because how long a frame stays on screen
+  // (repeats for Y4M, delay for GIF) is only known once the next one arrives.
+  Frame pending{};
+  long pendingNumber = -1;  // Position on the 60 fps timeline.
+};
@@ -0,0 +1,102 @@
+#include "cfg.hpp"
+
+#include <algorithm>
+#include <set>
+
+Flow ClassifyOpcode(uint16_t opcode) {
+  switch ((opcode & 0xF000u) >> 12u) {
+    case 0x0:
+      return (opcode == 0x00EEu) ? Flow::RETURN : Flow::NEXT;
+    case 0x1:
+      return Flow::JUMP;
+    case 0x2:
+      return Flow::CALL;
+    case 0x3:
+    case 0x4:
+    case 0x5:
+    case 0x9:
+      return Flow::SKIP;
+    case 0xB:
+      return Flow::INDIRECT;
+    case 0xE: {
+      uint8_t low = opcode & 0x00FFu;
+      return (low == 0x9E || low == 0xA1) ? Flow::SKIP : Flow::NEXT;
+    }
+    case 0xF:
+      return ((opcode & 0x00FFu) == 0x0A) ? Flow::WAIT : Flow::NEXT;
+    default:
+      return Flow::NEXT;
+  }
+}
+
+std::vector<BasicBlock> BuildCfg(uint8_t const* rom, size_t size,
+                                 uint16_t base, uint16_t entry,
+                                 unsigned int maxInstructions) {
+  std::vector<BasicBlock> blocks;
+  std::set<uint16_t> seen;
+  std::vector<uint16_t> worklist = {entry};
+
+  auto inRom = [&](uint16_t address) {
+    return address >= base && address + 1u < base + size;
+  };
+
+  while (!worklist.empty()) {
+    uint16_t start = worklist.back();
+    worklist.pop_back();
+
+    if (!inRom(start) || !seen.insert(start).second) {
+      continue;
+    }
+
+    BasicBlock block{start, start, Flow::NEXT, {}};
+    uint16_t address = start;
+
+    for (unsigned int count = 0; inRom(address); count++) {
+      if (count == maxInstructions) {
+        // Long straight run: cut it and continue in a new block.
+        block.successors.push_back(address);
+        break;
+      }
+
+      uint16_t opcode = (rom[address - base] << 8u) | rom[address - base + 1];
+      uint16_t nnn = opcode & 0x0FFFu;
+      Flow flow = ClassifyOpcode(opcode);
+      address += 2;
+
+      if (flow == Flow::NEXT) {
+        continue;
+      }
+
+      block.exit = flow;
+      switch (flow) {
+        case Flow::JUMP:
+          block.successors = {nnn};
+          break;
+        case Flow::CALL:
+          block.successors = {nnn, address};
+          break;
+        case Flow::SKIP:
+          block.successors = {address, static_cast<uint16_t>(address + 2)};
+          break;
+        case Flow::WAIT:
+          block.successors = {static_cast<uint16_t>(address - 2), address};
+          break;
+        default:
+          // RETURN and INDIRECT: the target is only known at run time.
+          break;
+      }
+      break;
+    }
+
+    block.end = address;
+    worklist.insert(worklist.end(), block.successors.begin(),
+                    block.successors.end());
+    blocks.push_back(block);
+  }
+
+  std::sort(blocks.begin(), blocks.end(),
+            [](BasicBlock const& a, BasicBlock const& b) {
+              return a.start < b.start;
+            });
+  return blocks;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Static control-flow analysis of a ROM, for tools that look at a program
+// without running it (the ahead-of-time recompiler, the ROM library).
+
+// How an instruction hands over to the next one.
+enum class Flow : uint8_t {
+  NEXT,      // Falls through to pc + 2.
+  JUMP,      // 1nnn: goes to nnn.
+  CALL,      // 2nnn: goes to nnn, comes back to pc + 2 later.
+  RETURN,    // 00EE: goes back to whoever called.
+  SKIP,      // 3xkk, 4xkk, 5xy0, 9xy0, Ex9E, ExA1: pc + 2 or pc + 4.
+  INDIRECT,  // Bnnn: target depends on a register, unknown ahead of time.
+  WAIT,      // Fx0A: repeats itself until a key is pressed.
+};
+
+Flow ClassifyOpcode(uint16_t opcode);
+
+// A straight run of instructions with one way in (the first) and control
+// flow only at the end.
+struct BasicBlock {
+  uint16_t start;
+  uint16_t end;  // One past the last byte of the last instruction.
+  Flow exit;
+  // Where execution can continue, when known ahead of time.
+  std::vector<uint16_t> successors;
+};
+
+// Follow every statically known path from "entry" through the ROM loaded at
+// "base". Blocks are cut after "maxInstructions" so no block runs too long
+// without returning to its caller. Sorted by start address.
+std::vector<BasicBlock> BuildCfg(uint8_t const* rom, size_t size,
+                                 uint16_t base, uint16_t entry,
+                                 unsigned int maxInstructions = 32);
@@ -1,6 +1,10 @@
 #include "chip8.hpp"
+#include "coverage.hpp"
+#include "recompiled.hpp"
 
-#include <SDL3/SDL_keycode.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 
 #include <fstream>
 
@@ -28,14 +32,36 @@ uint8_t fontset[FONTSET_SIZE] = {
     0xF0, 0x80, 0xF0, 0x80, 0x80   // F
 };
 
+// SUPER-CHIP's large digits for Fx30: 10 characters, 10 bytes (rows) each,
+// right after the small font.
+const unsigned int BIG_FONTSET_SIZE = 100;
+const unsigned int BIG_FONTSET_START_ADDRESS =
+    FONTSET_START_ADDRESS + FONTSET_SIZE;
+
+uint8_t bigFontset[BIG_FONTSET_SIZE] = {
+    0x3C, 0x7E, 0xE7, 0xC3, 0xC3, 0xC3, 0xC3, 0xE7, 0x7E, 0x3C,  // 0
+    0x18, 0x38, 0x58, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C,  // 1
+    0x3E, 0x7F, 0xC3, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xFF, 0xFF,  // 2
+    0x3C, 0x7E, 0xC3, 0x03, 0x0E, 0x0E, 0x03, 0xC3, 0x7E, 0x3C,  // 3
+    0x06, 0x0E, 0x1E, 0x36, 0x66, 0xC6, 0xFF, 0xFF, 0x06, 0x06,  // 4
+    0xFF, 0xFF, 0xC0, 0xC0, 0xFC, 0xFE, 0x03, 0xC3, 0x7E, 0x3C,  // 5
+    0x3E, 0x7C, 0xC0, 0xC0, 0xFC, 0xFE, 0xC3, 0xC3, 0x7E, 0x3C,  // 6
+    0xFF, 0xFF, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x60, 0x60,  // 7
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7E, 0x7E, 0xC3, 0xC3, 0x7E, 0x3C,  // 8
+    0x3C, 0x7E, 0xC3, 0xC3, 0x7F, 0x3F, 0x03, 0x03, 0x3E, 0x7C   // 9
+};
+
 Chip8::Chip8()
     : randGen(std::chrono::system_clock::now().time_since_epoch().count()) {
   // Initialize Program Counter (PC)
   pc = START_ADDRESS;
 
   // Load fonts into memory
-  for (const unsigned char i : fontset) {
-    memory[FONTSET_START_ADDRESS + 1] = i;
+  for (unsigned int i = 0; i < FONTSET_SIZE; i++) {
+    memory[FONTSET_START_ADDRESS + i] = fontset[i];
+  }
+  for (unsigned int i = 0; i < BIG_FONTSET_SIZE; i++) {
+    memory[BIG_FONTSET_START_ADDRESS + i] = bigFontset[i];
   }
 
   // Initialize RNG
@@ -54,22 +80,28 @@ Chip8::Chip8()
   table[0x8] = &Chip8::Table8;
   table[0x9] = &Chip8::OP_9xy0;
   table[0xA] = &Chip8::OP_Annn;
-  table[0xB] = &Chip8::OP_Bnnn;
+  // 0xB is set by SetVariant.
   table[0xC] = &Chip8::OP_Cxkk;
-  table[0xD] = &Chip8::OP_Dxyn;
+  // 0xD is set by SetVariant.
   table[0xE] = &Chip8::TableE;
   table[0xF] = &Chip8::TableF;
 
-  // ========== Initialize Tables with array size 0xE ==========
-  for (size_t i = 0; i <= 0xE; i++) {
-    table0[i] = &Chip8::OP_NULL;
+  // ========== Initialize Tables with array size 0xF + 1 ==========
+  for (size_t i = 0; i <= 0xF; i++) {
     table8[i] = &Chip8::OP_NULL;
     tableE[i] = &Chip8::OP_NULL;
   }
 
-  // ========== Table for $00EN ==========
-  table0[0x0] = &Chip8::OP_00E0;
-  table0[0xE] = &Chip8::OP_00EE;
+  // ========== Initialize Tables with array size 0xFF + 1 ==========
+  for (size_t i = 0; i <= 0xFF; i++) {
+    table0[i] = &Chip8::OP_NULL;
+    tableF[i] = &Chip8::OP_NULL;
+  }
+
+  // ========== Table for $00NN ==========
+  table0[0xE0] = &Chip8::OP_00E0;
+  table0[0xEE] = &Chip8::OP_00EE;
+  // 0xCn and 0xFB-0xFF are set by SetVariant.
 
   // ========== Table for $8xyN ==========
   table8[0x0] = &Chip8::OP_8xy0;
@@ -78,19 +110,13 @@ Chip8::Chip8()
   table8[0x3] = &Chip8::OP_8xy3;
   table8[0x4] = &Chip8::OP_8xy4;
   table8[0x5] = &Chip8::OP_8xy5;
-  table8[0x6] = &Chip8::OP_8xy6;
   table8[0x7] = &Chip8::OP_8xy7;
-  table8[0xE] = &Chip8::OP_8xyE;
+  // 0x6 and 0xE are set by SetVariant.
 
   // ========== Table for $ExNN ==========
   tableE[0x1] = &Chip8::OP_ExA1;
   tableE[0xE] = &Chip8::OP_Ex9E;
 
-  // ========== Initialize Tables with array size 0x65 + 1 ==========
-  for (size_t i = 0; i <= 0x65; i++) {
-    tableF[i] = &Chip8::OP_NULL;
-  }
-
   // ========== Table for $FxNN ==========
   tableF[0x07] = &Chip8::OP_Fx07;
   tableF[0x0A] = &Chip8::OP_Fx0A;
@@ -99,8 +125,65 @@ Chip8::Chip8()
   tableF[0x1E] = &Chip8::OP_Fx1E;
   tableF[0x29] = &Chip8::OP_Fx29;
   tableF[0x33] = &Chip8::OP_Fx33;
-  tableF[0x55] = &Chip8::OP_Fx55;
-  tableF[0x65] = &Chip8::OP_Fx65;
+  // 0x30, 0x55 and 0x65 are set by SetVariant.
+
+  // ========== Quirk-dependent entries ==========
+  SetVariant(Variant::CHIP8);
+}
+
+void Chip8::SetVariant(Variant newVariant) {
+  variant = newVariant;
+
+  switch (variant) {
+    case Variant::CHIP8:
+      InstallQuirks<Chip8Quirks>();
+      break;
+    case Variant::SCHIP:
+      InstallQuirks<SuperChipQuirks>();
+      break;
+    case Variant::XOCHIP:
+      InstallQuirks<XoChipQuirks>();
+      break;
+  }
+}
+
+Variant Chip8::GetVariant() const { return variant; }
+
+// Each call instantiates the handlers below once for "Quirks", so the
+// variant is decided here, at load time, instead of inside every
+// instruction.
+template <typename Quirks>
+void Chip8::InstallQuirks() {
+  table[0xB] = &Chip8::OP_Bnnn<Quirks>;
+  table[0xD] = &Chip8::OP_Dxyn<Quirks>;
+  table8[0x6] = &Chip8::OP_8xy6<Quirks>;
+  table8[0xE] = &Chip8::OP_8xyE<Quirks>;
+  tableF[0x55] = &Chip8::OP_Fx55<Quirks>;
+  tableF[0x65] = &Chip8::OP_Fx65<Quirks>;
+
+  // Without them these stay (or go back to) unknown opcodes.
+  Chip8Func scrollDown = &Chip8::OP_NULL;
+  Chip8Func scrollRight = &Chip8::OP_NULL;
+  Chip8Func scrollLeft = &Chip8::OP_NULL;
+  Chip8Func lowRes = &Chip8::OP_NULL;
+  Chip8Func highRes = &Chip8::OP_NULL;
+  Chip8Func bigDigit = &Chip8::OP_NULL;
+  if constexpr (Quirks::SUPER_CHIP_DISPLAY) {
+    scrollDown = &Chip8::OP_00Cn;
+    scrollRight = &Chip8::OP_00FB;
+    scrollLeft = &Chip8::OP_00FC;
+    lowRes = &Chip8::OP_00FE;
+    highRes = &Chip8::OP_00FF;
+    bigDigit = &Chip8::OP_Fx30;
+  }
+  for (size_t n = 0; n <= 0xF; n++) {
+    table0[0xC0 + n] = scrollDown;
+  }
+  table0[0xFB] = scrollRight;
+  table0[0xFC] = scrollLeft;
+  table0[0xFE] = lowRes;
+  table0[0xFF] = highRes;
+  tableF[0x30] = bigDigit;
 }
 
 void Chip8::LoadROM(const char *filename) {
@@ -123,16 +206,34 @@ void Chip8::LoadROM(const char *filename) {
     // Already loaded the ROM into buffer, close the file.
     file.close();
 
-    // Load ROM contents into CHIP-8's memory, starting from 0x200.
-    for (long i = 0; i < size; i++) {
-      memory[START_ADDRESS + i] = buffer[i];
-    }
+    LoadROM(reinterpret_cast<uint8_t const *>(buffer), size);
 
     delete[] buffer;
   }
 }
 
+void Chip8::LoadROM(uint8_t const *data, size_t size) {
+  // Load ROM contents into CHIP-8's memory, starting from 0x200.
+  size = std::min<size_t>(size, MEM_SIZE - START_ADDRESS);
+  for (size_t i = 0; i < size; i++) {
+    memory[START_ADDRESS + i] = data[i];
+  }
+}
+
 void Chip8::Cycle() {
+  if (halted) [[unlikely]] {
+    return;
+  }
+
+  if (pc > MEM_SIZE - 2) [[unlikely]] {
+    opcode = 0;
+    if (RaiseFault(Fault::PC_RANGE, pc)) {
+      return;
+    }
+    // Stand-in: wrap around into memory.
+    pc &= 0x0FFEu;
+  }
+
   // Fetch current opcode
   opcode = (memory[pc] << 8u) | memory[pc + 1];
 
@@ -145,6 +246,7 @@ void Chip8::Cycle() {
   // this->*: Applies the function pointer to the current Chip8 instance.
   // (): Calls the function.
   (this->*(table[(opcode & 0xF000u) >> 12u]))();
+  cycleCount++;
 
   // Chip-8 has two timers: delayTimer and soundTimer, both 8-bit values that
   // decrement at 60 Hz when non-zero. In an emulator, the Cycle() function
@@ -153,6 +255,12 @@ void Chip8::Cycle() {
   // approximately 60 Hz for timing purposes. (In a real implementation, you’d
   // separate timer updates into a 60 Hz loop, but let’s keep it simple for
   // now.)
+  if (!externalTimers) {
+    TickTimers();
+  }
+}
+
+void Chip8::TickTimers() {
   if (delayTimer > 0) {
     // delayTimer: Used for game timing (e.g., Fx15 sets it, Fx07 reads it).
     --delayTimer;
@@ -165,6 +273,246 @@ void Chip8::Cycle() {
   }
 }
 
+bool Chip8::AttachRecompiled(RecompiledRom const *rom) {
+  if (rom->variant != variant ||
+      rom->imageSize > MEM_SIZE - START_ADDRESS ||
+      std::memcmp(rom->image, &memory[START_ADDRESS], rom->imageSize) != 0) {
+    return false;
+  }
+
+  recompiledBlocks.assign(MEM_SIZE, nullptr);
+  isCode.assign(MEM_SIZE, false);
+  codeStart = MEM_SIZE;
+  codeEnd = 0;
+
+  for (uint16_t i = 0; i < rom->blockCount; i++) {
+    RecompiledBlock const &block = rom->blocks[i];
+    recompiledBlocks[block.address] = block.run;
+    std::fill(isCode.begin() + block.address, isCode.begin() + block.end, true);
+    codeStart = std::min(codeStart, block.address);
+    codeEnd = std::max(codeEnd, block.end);
+  }
+
+  return true;
+}
+
+unsigned long Chip8::RunCycles(unsigned long count) {
+  unsigned long executed = 0;
+
+  // Recompiled blocks run several instructions at once, so only use them
+  // while a whole block still fits in the budget.
+  while (count - executed >= RECOMPILED_MAX_BLOCK && !halted) {
+    executed += Step();
+  }
+
+  while (executed < count && !halted) {
+    Cycle();
+    executed++;
+  }
+
+  return executed;
+}
+
+unsigned long Chip8::RunFrames(unsigned long count) {
+  return RunCycles(count * cyclesPerFrame);
+}
+
+void Chip8::SetCyclesPerFrame(unsigned int cycles) { cyclesPerFrame = cycles; }
+
+void Chip8::SetExternalTimers(bool external) { externalTimers = external; }
+
+unsigned long Chip8::RunUntilWait(unsigned long count) {
+  unsigned long executed = 0;
+  wait = halted ? WaitReason::HALTED : WaitReason::NONE;
+
+  while (executed < count && wait == WaitReason::NONE) {
+    if (count - executed >= RECOMPILED_MAX_BLOCK) {
+      executed += Step();
+    } else {
+      Cycle();
+      executed++;
+    }
+  }
+
+  return executed;
+}
+
+WaitReason Chip8::Waiting() const { return wait; }
+
+unsigned long Chip8::RunCyclesCovered(unsigned long count,
+                                      Coverage &coverage) {
+  unsigned long executed = 0;
+
+  while (executed < count && !halted) {
+    uint16_t from = pc;
+    Cycle();
+    coverage.Mark(from, pc);
+    executed++;
+  }
+
+  return executed;
+}
+
+void Chip8::SetKey(uint8_t key, bool pressed) {
+  keypad[key & 0xFu] = pressed ? 1 : 0;
+}
+
+void Chip8::SetFaultPolicy(FaultPolicy policy) { faultPolicy = policy; }
+
+FaultInfo Chip8::FirstFault() const { return firstFault; }
+
+uint32_t Chip8::FaultCount() const { return faultCount; }
+
+bool Chip8::Halted() const { return halted; }
+
+uint64_t Chip8::CycleCount() const { return cycleCount; }
+
+bool Chip8::RaiseFault(Fault fault, uint16_t address) {
+  if (faultPolicy == FaultPolicy::IGNORE) {
+    return false;
+  }
+
+  if (faultCount++ == 0) {
+    firstFault = {fault, address, opcode, cycleCount};
+  }
+
+  if (faultPolicy == FaultPolicy::HALT) {
+    halted = true;
+    pc = address;
+    wait = WaitReason::HALTED;
+    return true;
+  }
+  return false;
+}
+
+char const *FaultName(Fault fault) {
+  switch (fault) {
+    case Fault::NONE:
+      return "none";
+    case Fault::UNKNOWN_OPCODE:
+      return "unknown opcode";
+    case Fault::STACK_UNDERFLOW:
+      return "stack underflow";
+    case Fault::STACK_OVERFLOW:
+      return "stack overflow";
+    case Fault::MEMORY_RANGE:
+      return "memory access past 0xFFF";
+    case Fault::PC_RANGE:
+      return "pc past 0xFFF";
+    case Fault::KEY_RANGE:
+      return "key above 0xF";
+  }
+  return "unknown";
+}
+
+bool ParseFaultPolicy(char const *name, FaultPolicy &policy) {
+  if (std::strcmp(name, "ignore") == 0) {
+    policy = FaultPolicy::IGNORE;
+  } else if (std::strcmp(name, "trap") == 0) {
+    policy = FaultPolicy::TRAP;
+  } else if (std::strcmp(name, "halt") == 0) {
+    policy = FaultPolicy::HALT;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool Chip8::HiRes() const { return hires; }
+
+unsigned int Chip8::DisplayWidth() const {
+  return hires ? HIRES_WIDTH : PX_WIDTH;
+}
+
+unsigned int Chip8::DisplayHeight() const {
+  return hires ? HIRES_HEIGHT : PX_HEIGHT;
+}
+
+uint64_t const *Chip8::DisplayRows() const { return display[0]; }
+
+uint32_t const *Chip8::Video() const {
+  if (!videoStale) {
+    return video;
+  }
+
+  for (unsigned int y = 0; y < PX_HEIGHT; y++) {
+    uint32_t *out = &video[y * PX_WIDTH];
+    if (!hires) {
+      uint64_t bits = display[y][0];
+      for (unsigned int x = 0; x < PX_WIDTH; x++) {
+        out[x] = (bits >> (63 - x)) & 1u ? 0xFFFFFFFFu : 0;
+      }
+      continue;
+    }
+
+    // Two hi-res rows, and then two pixels of that, per lo-res pixel.
+    for (unsigned int w = 0; w < DISPLAY_WORDS; w++) {
+      uint64_t bits = display[2 * y][w] | display[2 * y + 1][w];
+      bits |= bits << 1;
+      for (unsigned int x = 0; x < 32; x++) {
+        out[w * 32 + x] = (bits >> (63 - 2 * x)) & 1u ? 0xFFFFFFFFu : 0;
+      }
+    }
+  }
+
+  videoStale = false;
+  return video;
+}
+
+uint8_t const *Chip8::Memory() const { return memory; }
+
+uint8_t const *Chip8::Registers() const { return registers; }
+
+uint16_t Chip8::Pc() const { return pc; }
+
+uint16_t Chip8::Index() const { return index; }
+
+uint8_t Chip8::DelayTimer() const { return delayTimer; }
+
+uint8_t Chip8::SoundTimer() const { return soundTimer; }
+
+uint16_t const *Chip8::Stack() const { return stack; }
+
+uint8_t Chip8::StackDepth() const { return sp; }
+
+void Chip8::Seed(uint32_t seed) { randGen.seed(seed); }
+
+unsigned int Chip8::Step() {
+  if (halted) [[unlikely]] {
+    return 0;
+  }
+
+  if (codeEnd != 0 && pc < MEM_SIZE) {
+    RecompiledFunc block = recompiledBlocks[pc];
+    if (block) {
+      unsigned int executed = block(*this);
+      cycleCount += executed;
+      return executed;
+    }
+  }
+
+  Cycle();
+  return 1;
+}
+
+void Chip8::CheckCodeWrite(unsigned int address, unsigned int size) {
+  // Cheap range test first; without recompiled code codeEnd is 0 and this
+  // is the only work done.
+  if (address >= codeEnd || address + size <= codeStart) {
+    return;
+  }
+
+  for (unsigned int i = address; i < address + size && i < MEM_SIZE; i++) {
+    if (isCode[i]) {
+      // Self-modifying code: the translation no longer matches memory.
+      codeEnd = 0;
+      return;
+    }
+  }
+}
+
+bool Chip8::SoundOn() const { return soundTimer > 0; }
+
 // "this" keyword is a pointer to the current Chip8 object instance.
 // "(*this)" or "(this)->" deference "this"(pointer) to get the object.
 // These dispatch functions get the emulator instance,
@@ -176,28 +524,80 @@ void Chip8::Cycle() {
 // ".*(...)()" calls a member function pointer on an object.
 // (...) groups the expression.
 // the final () calls the underlying function (eg. OP_8xy4()).
-void Chip8::Table0() { ((this)->*(table0[opcode & 0x000Fu]))(); }
+void Chip8::Table0() { ((this)->*(table0[opcode & 0x00FFu]))(); }
 void Chip8::Table8() { ((this)->*(table8[opcode & 0x000Fu]))(); }
 void Chip8::TableE() { ((this)->*(tableE[opcode & 0x000Fu]))(); }
 void Chip8::TableF() { ((this)->*(tableF[opcode & 0x00FFu]))(); }
 
-// Dummy function, would be called if a non-existent opcode gets called.
-void Chip8::OP_NULL() {}
+// Called for opcodes that don't exist. Stand-in: do nothing.
+void Chip8::OP_NULL() { RaiseFault(Fault::UNKNOWN_OPCODE, pc - 2); }
 
 // CLS. Clears the screen.
-void Chip8::OP_00E0() { memset(video, 0, sizeof(video)); }
+void Chip8::OP_00E0() {
+  memset(display, 0, sizeof(display));
+  videoStale = true;
+}
+
+// Scroll down n rows (of the current mode's pixels). Rows are whole words,
+// so this is one memmove and a memset for the rows that come in at the top.
+void Chip8::OP_00Cn() {
+  unsigned int n = opcode & 0x000Fu;
+  unsigned int height = DisplayHeight();
+
+  memmove(display[n], display[0], (height - n) * sizeof(display[0]));
+  memset(display[0], 0, n * sizeof(display[0]));
+  videoStale = true;
+}
+
+// Scroll right 4 pixels. A lo-res row is one word; a hi-res row shifts as
+// one 128-bit number, the bits leaving the left word entering the right one.
+void Chip8::OP_00FB() {
+  for (unsigned int y = 0; y < DisplayHeight(); y++) {
+    uint64_t *row = display[y];
+    if (hires) {
+      row[1] = (row[1] >> 4) | (row[0] << 60);
+    }
+    row[0] >>= 4;
+  }
+  videoStale = true;
+}
+
+// Scroll left 4 pixels.
+void Chip8::OP_00FC() {
+  for (unsigned int y = 0; y < DisplayHeight(); y++) {
+    uint64_t *row = display[y];
+    row[0] <<= 4;
+    if (hires) {
+      row[0] |= row[1] >> 60;
+      row[1] <<= 4;
+    }
+  }
+  videoStale = true;
+}
+
+// Switching resolution clears the screen, as modern interpreters do, rather
+// than leaving the old pixels to be reinterpreted at the new size.
+void Chip8::OP_00FE() {
+  hires = false;
+  OP_00E0();
+}
+
+void Chip8::OP_00FF() {
+  hires = true;
+  OP_00E0();
+}
 
 // RET. minus 1 stack level.
 void Chip8::OP_00EE() {
-  // Requires safety check for stack level below 0,
-  // unsigned int wraparound if out of 0 to 255.
-  // if (sp == 0) {
-  //   pc = stack[sp];  // Needs error handling.
-  // } else {
-  //   // Move sp down.
+  // Nothing to return to. Stand-in: carry on after the 00EE.
+  if (sp == 0) [[unlikely]] {
+    RaiseFault(Fault::STACK_UNDERFLOW, pc - 2);
+    return;
+  }
+
+  // Move sp down.
   sp--;
   pc = stack[sp];
-  // }
 }
 
 // Jump to address nnn
@@ -217,19 +617,23 @@ void Chip8::OP_1nnn() {
 // Analogy: You were told to visit a place (nnn),
 // but you plan to return where you are now.
 void Chip8::OP_2nnn() {
+  // No room for the return address. Stand-in: jump without saving it.
+  if (sp >= STACK_LEVELS) [[unlikely]] {
+    if (RaiseFault(Fault::STACK_OVERFLOW, pc - 2)) {
+      return;
+    }
+    pc = opcode & 0x0FFFu;
+    return;
+  }
+
   // Put current PC onto the top of the stack.
   // Analogy: Before leaving your current place,
   // you write down the next place's address in your notebook(stack)
   stack[sp] = pc;
 
   // Move SP up one level.
-  // Safety check to prevent overflow & wrap around.
   // Analogy: You start a new page on your notebook (sp++),
-  if (sp >= STACK_LEVELS) {
-    sp = STACK_LEVELS;  // Needs error handling.
-  } else {
-    sp++;
-  }
+  sp++;
 
   // PC jumps to the address nnn
   // Analogy: then you move to the new place (nnn).
@@ -298,7 +702,7 @@ void Chip8::OP_5xy0() {
   //   |     4-bit register index (x)
   //   Opcode (5)
   uint8_t x = (opcode & 0x0F00u) >> 8u;
-  uint8_t y = (opcode & 0x00F0u) >> 8u;
+  uint8_t y = (opcode & 0x00F0u) >> 4u;
 
   if (registers[x] == registers[y]) {
     pc += 2;
@@ -443,12 +847,24 @@ void Chip8::OP_8xy5() {
 // If the least-significant bit of Vx is 1, then VF is set to 1, otherwise 0.
 // Then Vx is divided by 2. A right shift is performed (division by 2), and the
 // least significant bit is saved in Register VF.
+//
+// On the original COSMAC VIP the source is Vy (Vx = Vy >> 1); SUPER-CHIP
+// ignores Vy and shifts Vx in place. VF is written last, so the flag wins
+// when x is F.
+template <typename Quirks>
 void Chip8::OP_8xy6() {
   uint8_t x = (opcode & 0x0F00u) >> 8u;
-  // uint8_t lsb = registers[x] & 0x1u;
+  uint8_t y = (opcode & 0x00F0u) >> 4u;
+
+  uint8_t source = registers[x];
+  if constexpr (Quirks::SHIFT_USES_VY) {
+    source = registers[y];
+  }
+
+  // uint8_t lsb = source & 0x1u;
   // registers[0xF] = (lsb) ? 1 : 0;
-  registers[0xF] = (registers[x] & 0x1u);
-  registers[x] >>= 1;
+  registers[x] = source >> 1;
+  registers[0xF] = (source & 0x1u);
 }
 
 // Set Vx = Vy - Vx, set VF = NOT borrow.
@@ -465,6 +881,7 @@ void Chip8::OP_8xy7() {
 // If the most-significant bit(MSB) of Vx is 1, then VF is set to 1, otherwise
 // to 0. Then Vx is multiplied by 2. A left shift is performed (multiplication
 // by 2), and the most significant bit is saved in Register VF.
+template <typename Quirks>
 void Chip8::OP_8xyE() {
   // 16-bit instruction: 0x8xyE
   // Binary: 1000 xxxx yyyy 1110
@@ -478,19 +895,23 @@ void Chip8::OP_8xyE() {
   //   |     4-bit register index (x)
   //   Opcode (8)
   uint8_t x = (opcode & 0x0F00u) >> 8u;
+  uint8_t y = (opcode & 0x00F0u) >> 4u;
   // Note on y:
-  // In most modern CHIP-8 implementations,
-  // 8xyE ignores Vy and uses Vx = Vx << 1.
-  // If your emulator follows the original COSMAC VIP spec, it might use
-  // Vx = Vy << 1. Let’s assume Vx = Vx << 1 (standard).
+  // SUPER-CHIP (and most "modern" interpreters) ignore Vy and use
+  // Vx = Vx << 1. The original COSMAC VIP uses Vx = Vy << 1.
+  // Which one we get is decided by the quirk policy.
+  uint8_t source = registers[x];
+  if constexpr (Quirks::SHIFT_USES_VY) {
+    source = registers[y];
+  }
 
   // 0x80 = 128
   // V[x]: 1000 0000  (0x80)
   // MSB:  ^ (1, so VF = 1)
   // Shift: 0000 0000  (0x00)
   // V[x] after: 0000 0000
-  registers[0xF] = (registers[x] & 0x0080u) ? 1 : 0;
-  registers[x] <<= 1;
+  registers[x] = source << 1;
+  registers[0xF] = (source & 0x0080u) ? 1 : 0;
 }
 
 // Skip next instruction if Vx != Vy.
@@ -509,6 +930,9 @@ void Chip8::OP_9xy0() {
 void Chip8::OP_Annn() { index = opcode & 0x0FFFu; }
 
 // Jump to location nnn + V0.
+// SUPER-CHIP reads the instruction as Bxnn instead: jump to xnn + Vx,
+// where x is the top digit of the address.
+template <typename Quirks>
 void Chip8::OP_Bnnn() {
   // Before:
   // V0 = 0x10
@@ -521,7 +945,14 @@ void Chip8::OP_Bnnn() {
   // pc = 0x210 (0x200 + 0x10)
   // I = 0x200 (unchanged)
   // V1-VF = (unchanged)
-  pc = opcode & 0x0FFFu + registers[0];
+  uint16_t addr = opcode & 0x0FFFu;
+
+  if constexpr (Quirks::JUMP_USES_VX) {
+    uint8_t x = (opcode & 0x0F00u) >> 8u;
+    pc = addr + registers[x];
+  } else {
+    pc = addr + registers[0];
+  }
 }
 
 // Set Vx = random byte bitwise AND kk.
@@ -539,116 +970,107 @@ void Chip8::OP_Cxkk() {
 // Display n-byte sprite starting at memory location I at (Vx, Vy), set VF =
 // collision.
 //
-// We iterate over the sprite, row by row and column by column. We know there
-// are eight columns because a sprite is guaranteed to be eight pixels wide.
+// The display is rows of packed pixels (see DISPLAY_WORDS), so a sprite row
+// is drawn a whole row at a time rather than pixel by pixel. The sprite's
+// bits are moved to the top of a word, leftmost pixel first, then shifted
+// right by the x position within the word. Whatever falls off the end lands
+// in the next word (hi-res rows have two), or off the edge of the screen.
 //
-// If a sprite pixel is on then there may be a collision with what’s already
-// being displayed, so we check if our screen pixel in the same location is set.
-// If so we must set the VF register to express collision.
+// If any bit of the sprite row meets a lit bit on the screen, a pixel turns
+// off, and VF is set to express collision. Then the screen word is XORed
+// with the sprite bits in one go.
 //
-// Then we can just XOR the screen pixel with 0xFFFFFFFF to essentially XOR it
-// with the sprite pixel (which we now know is on). We can’t XOR directly
-// because the sprite pixel is either 1 or 0 while our video pixel is either
-// 0x00000000 or 0xFFFFFFFF.
+// The starting position always wraps onto the screen. What happens to the
+// parts of the sprite that then run off the edge depends on the variant:
+// XO-CHIP wraps them around to the other side, the others clip them.
+template <typename Quirks>
 void Chip8::OP_Dxyn() {
   uint8_t x = (opcode & 0x0F00u) >> 8u;  // bits 8-11
   uint8_t y = (opcode & 0x00F0u) >> 4u;  // bits 4-7
-  uint8_t height = opcode & 0x000Fu;     // bits 0-3
+  unsigned int height = opcode & 0x000Fu;  // bits 0-3
+
+  // Dxy0 is a 16x16 sprite, two bytes per row, where SUPER-CHIP has them.
+  unsigned int bytesPerRow = 1;
+  if constexpr (Quirks::SUPER_CHIP_DISPLAY) {
+    if (height == 0) {
+      height = 16;
+      bytesPerRow = 2;
+    }
+  }
+
+  // The sprite would be read from past 0xFFF. Stand-in: draw nothing.
+  if (index + height * bytesPerRow > MEM_SIZE) [[unlikely]] {
+    RaiseFault(Fault::MEMORY_RANGE, pc - 2);
+    return;
+  }
 
-  // (0 to 255, but only 0-63 matters for 64-wide screen).
-  uint8_t x_cord = registers[x] % PX_WIDTH;
-  // (or x_coord & 0x3F) to stay in 0-63.
+  unsigned int width = DisplayWidth();
+  unsigned int screenHeight = DisplayHeight();
+  unsigned int words = width / 64;
 
-  // (0 to 255, 0-31 for 32-high screen).
-  uint8_t y_cord = registers[y] % PX_HEIGHT;
-  // (or y_coord & 0x1F) to stay in 0-31.
+  // Both sizes are powers of two, so % is a mask.
+  unsigned int x_cord = registers[x] % width;
+  unsigned int y_cord = registers[y] % screenHeight;
 
-  // What it does: Clears the collision flag (VF, register 15) before drawing.
-  // Purpose: VF will be set to 1 if any pixel flips from on (0xFFFFFFFF) to off
-  // (0x00000000).
-  registers[0xFu] = 0;
+  // Which word the sprite starts in, and how far into it.
+  unsigned int word = x_cord / 64;
+  unsigned int shift = x_cord % 64;
+
+  uint64_t collision = 0;
 
-  // Analogy: Think of drawing a sprite as painting a grid on a canvas:
-  // The sprite is a stencil with n rows, each 8 holes wide (bits).
-  // You paint row-by-row, checking each hole (bit) to decide if you apply XOR
-  // paint at the canvas position (Vx + bit, Vy + row).
   for (unsigned int row = 0; row < height; row++) {
-    // Processes each row of the sprite,
-    // stored in memory[I] to memory[I + n - 1].
-    uint8_t spriteByte = memory[index + row];
-    for (unsigned int col = 0; col < 8; col++) {
-      // Bit Check: spritePx = spriteByte & (0x80u >> col);
-      // 0x80u = 10000000 (MSB set).
-      // 0x80u >> col: Shifts the 1 right (e.g., col = 0: 10000000, col = 1:
-      // 01000000, ..., col = 7: 00000001). spriteByte & (0x80u >> col): Tests
-      // if the col-th bit is 1 (non-zero if bit is 1, zero if bit is 0).
-
-      // Example: For spriteByte = 0xF0 (11110000):
-      // col = 0: 0xF0 & 0x80 = 11110000 & 10000000 = 10000000 (non-zero, bit 0
-      // = 1). col = 1: 0xF0 & 0x40 = 11110000 & 01000000 = 01000000 (non-zero,
-      // bit 1 = 1). col = 4: 0xF0 & 0x08 = 11110000 & 00001000 = 00000000
-      // (zero, bit 4 = 0).
-      uint8_t spritePx = spriteByte & (0x0080u >> col);
-
-      // ================== Setting individual pixel =========================
-      // Screen Position: uint32_t* screenPixel = &video[(yPos + row) *
-      // VIDEO_WIDTH + (xPos + col)];
-
-      // Calculates the video array index for pixel (xPos + col, yPos + row).
-      // VIDEO_WIDTH = 64.
-      // Formula: y * 64 + x maps 2D to 1D.
-      // Example: For xPos = 10, yPos = 5, row = 0, col = 0:
-      // x = 10 + 0 = 10, y = 5 + 0 = 5.
-      // video[5 * 64 + 10] = video[330].
-      // Uses a pointer (uint32_t*) to directly access and modify video[idx].
-
-      // Purpose: Checks each bit of the byte to decide if a pixel needs
-      // drawing, and computes the screen position.
-
-      // Analogy: For each row’s stencil, check 8 holes (bits). If a hole is
-      // open (bit = 1), paint at the corresponding canvas spot.
-
-      // (yPos + row): The y-coordinate on the screen (row of the sprite).
-
-      // (yPos + row) * VIDEO_WIDTH: Converts the y-coordinate to the start of
-      // the screen row in the 1D array (e.g., y=5 → 5 * 64 = 320).
-
-      // (xPos + col): The x-coordinate on the screen (column of the sprite).
-
-      // (yPos + row) * VIDEO_WIDTH + (xPos + col): The index in video for pixel
-      // (xPos + col, yPos + row).
-
-      // The &: &video[idx] returns a pointer (uint32_t*) to the pixel’s memory
-      // location, allowing direct modification (e.g., *screenPixel ^=
-      // 0xFFFFFFFF).
-      uint32_t *screenPx = &video[(y_cord + row) * PX_WIDTH + (x_cord + col)];
-
-      // check sprite pixel is on/off
-      //
-      // What it does:
-      // If the sprite bit is 1 (spritePixel non-zero),
-      // XOR the screen pixel and check for collision.
-      // Collision:
-      // If video[idx] = 0xFFFFFFFF (on) and
-      // XOR will turn it off (0xFFFFFFFF ^ 0xFFFFFFFF = 0),
-      // set VF = 1.
-      // XOR: *screenPixel ^= 0xFFFFFFFF flips the pixel (on to off, off to on).
-      if (spritePx) {
-        // check collision and if screen pixel is also on
-        if (*screenPx == 0xFFFFFFFFu) {
-          registers[0xFu] = 1;
-        }
+    unsigned int screenY = y_cord + row;
+    if constexpr (Quirks::SPRITES_WRAP) {
+      screenY %= screenHeight;
+    } else if (screenY >= screenHeight) {
+      break;
+    }
 
-        *screenPx ^= 0xFFFFFFFFu;
+    uint8_t const *spriteRow = &memory[index + row * bytesPerRow];
+    uint64_t sprite = spriteRow[0];
+    if (bytesPerRow == 2) {
+      sprite = (sprite << 8u) | spriteRow[1];
+    }
+    // Leftmost sprite pixel at the top bit, like the screen's.
+    sprite <<= 64 - 8 * bytesPerRow;
+
+    uint64_t *screenRow = display[screenY];
+
+    uint64_t left = sprite >> shift;
+    collision |= screenRow[word] & left;
+    screenRow[word] ^= left;
+
+    // The part that didn't fit in the first word (never more than a word,
+    // sprites being at most 16 wide).
+    uint64_t right = shift ? sprite << (64 - shift) : 0;
+    if (right) {
+      unsigned int next = word + 1;
+      if (next == words) {
+        if constexpr (!Quirks::SPRITES_WRAP) {
+          continue;
+        }
+        next = 0;
       }
+      collision |= screenRow[next] & right;
+      screenRow[next] ^= right;
     }
   }
+
+  registers[0xFu] = collision ? 1 : 0;
+  videoStale = true;
 }
 
 // Skip next instruction if key with the value of Vx is pressed.
 void Chip8::OP_Ex9E() {
-  uint8_t x = (opcode * 0x0F00u) >> 8u;
+  uint8_t x = (opcode & 0x0F00u) >> 8u;
   uint8_t key = registers[x];
+  // Stand-in for keys that don't exist: the low digit.
+  if (key >= KEY_COUNT) [[unlikely]] {
+    if (RaiseFault(Fault::KEY_RANGE, pc - 2)) {
+      return;
+    }
+    key &= 0xFu;
+  }
   // if pressed
   if (keypad[key]) {
     pc += 2;
@@ -659,6 +1081,12 @@ void Chip8::OP_Ex9E() {
 void Chip8::OP_ExA1() {
   uint8_t x = (opcode & 0x0F00u) >> 8u;
   uint8_t key = registers[x];
+  if (key >= KEY_COUNT) [[unlikely]] {
+    if (RaiseFault(Fault::KEY_RANGE, pc - 2)) {
+      return;
+    }
+    key &= 0xFu;
+  }
   if (!keypad[key]) {
     pc += 2;
   }
@@ -668,6 +1096,16 @@ void Chip8::OP_ExA1() {
 void Chip8::OP_Fx07() {
   uint8_t x = (opcode & 0x0F00u) >> 8u;
   registers[x] = delayTimer;
+
+  // With the timer ticked from outside, "Fx07; 3x00; JP back" spins until
+  // the next tick. Nothing else happens in that loop, so it can be parked.
+  if (externalTimers && delayTimer > 0 && pc + 4u <= MEM_SIZE) {
+    uint16_t skip = (memory[pc] << 8u) | memory[pc + 1];
+    uint16_t jump = (memory[pc + 2] << 8u) | memory[pc + 3];
+    if (skip == (0x3000u | (x << 8u)) && jump == (0x1000u | (pc - 2u))) {
+      wait = WaitReason::TIMER;
+    }
+  }
 }
 
 // Wait for a key press, store the value of the key in Vx.
@@ -677,15 +1115,16 @@ void Chip8::OP_Fx07() {
 // repeatedly.
 void Chip8::OP_Fx0A() {
   uint8_t x = (opcode & 0x0F00u) >> 8u;
-  // uint8_t key = registers[x];
-  for (uint8_t i = 0; i < 16; i++) {
+  for (uint8_t i = 0; i < KEY_COUNT; i++) {
     if (keypad[i]) {
       registers[x] = i;
-      pc += 2;
-      break;
+      return;
     }
-    pc -= 2;
   }
+
+  // No key down: run this instruction again next time.
+  pc -= 2;
+  wait = WaitReason::KEY;
 }
 
 // Set delay timer = Vx.
@@ -718,6 +1157,14 @@ void Chip8::OP_Fx29() {
   index = FONTSET_START_ADDRESS + (5 * digit);
 }
 
+// Set I = location of the large sprite for digit Vx.
+void Chip8::OP_Fx30() {
+  uint8_t x = (opcode & 0x0F00u) >> 8u;
+  uint8_t digit = registers[x];
+
+  index = BIG_FONTSET_START_ADDRESS + (10 * digit);
+}
+
 // Store BCD(binary-coded decimal) representation of Vx
 // in memory locations I, I+1, and I+2.
 //
@@ -735,6 +1182,14 @@ void Chip8::OP_Fx33() {
   // read Vx
   uint8_t value = registers[x];
 
+  // Stand-in when the digits don't fit below 0x1000: store nothing.
+  if (index + 3u > MEM_SIZE) [[unlikely]] {
+    RaiseFault(Fault::MEMORY_RANGE, pc - 2);
+    return;
+  }
+
+  CheckCodeWrite(index, 3);
+
   // Ones
   memory[index + 2] = value % 10;
   value /= 10;
@@ -748,19 +1203,46 @@ void Chip8::OP_Fx33() {
 }
 
 // Store registers V0 through Vx in memory starting at location I.
+// The COSMAC VIP (and XO-CHIP) leave I pointing just past the last byte.
+template <typename Quirks>
 void Chip8::OP_Fx55() {
   uint8_t x = (opcode & 0x0F00u) >> 8u;
 
+  // Stand-in when the registers don't fit below 0x1000: the whole
+  // instruction is skipped, I included.
+  if (index + x + 1u > MEM_SIZE) [[unlikely]] {
+    RaiseFault(Fault::MEMORY_RANGE, pc - 2);
+    return;
+  }
+
+  CheckCodeWrite(index, x + 1);
+
   for (uint8_t i = 0; i <= x; i++) {
     memory[index + i] = registers[i];
   }
+
+  if constexpr (Quirks::LOAD_STORE_INCREMENTS_I) {
+    index += x + 1;
+  }
 }
 
 // Read registers V0 through Vx from memory starting at location I.
+// The COSMAC VIP (and XO-CHIP) leave I pointing just past the last byte.
+template <typename Quirks>
 void Chip8::OP_Fx65() {
   uint8_t x = (opcode & 0x0F00u) >> 8u;
 
+  // As Fx55.
+  if (index + x + 1u > MEM_SIZE) [[unlikely]] {
+    RaiseFault(Fault::MEMORY_RANGE, pc - 2);
+    return;
+  }
+
   for (uint8_t i = 0; i <= x; i++) {
     registers[i] = memory[index + i];
   }
+
+  if constexpr (Quirks::LOAD_STORE_INCREMENTS_I) {
+    index += x + 1;
+  }
 }
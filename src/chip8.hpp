@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <random>
+#include <vector>
+
+#include "quirks.hpp"
 
 const unsigned int KEY_COUNT = 16;
 const unsigned int MEM_SIZE = 4096;
@@ -10,16 +14,195 @@ const unsigned int STACK_LEVELS = 16;
 const unsigned int PX_HEIGHT = 32;
 const unsigned int PX_WIDTH = 64;
 
+// SUPER-CHIP hi-res mode (00FF).
+const unsigned int HIRES_HEIGHT = 64;
+const unsigned int HIRES_WIDTH = 128;
+
+// The display is kept as rows of packed pixels, DISPLAY_WORDS words per row
+// (whether or not hi-res is on): pixel x is bit 63 - x % 64 of word x / 64,
+// so the leftmost pixel is the top bit, as in sprite bytes.
+const unsigned int DISPLAY_WORDS = HIRES_WIDTH / 64;
+
+class Chip8;
+struct Coverage;
+struct RecompiledRom;
+
+// A block of code translated ahead of time, see recompiled.hpp.
+typedef unsigned int (*RecompiledFunc)(Chip8 &);
+
+// Why Chip8::RunUntilWait() stopped before running every instruction.
+enum class WaitReason : uint8_t {
+  NONE,
+  // Fx0A found no key down; pc stays on it until one is.
+  KEY,
+  // The program is in the usual delay loop (Fx07, 3x00, then a 1nnn back to
+  // the Fx07) with the delay timer still running. Only with external
+  // timers: otherwise the timer runs out within the loop's own cycles.
+  TIMER,
+  // Halted by a fault (FaultPolicy::HALT); nothing will run again.
+  HALTED,
+};
+
+// Things a program can do that no interpreter can carry out as written.
+enum class Fault : uint8_t {
+  NONE,
+  UNKNOWN_OPCODE,      // Not a CHIP-8 instruction.
+  STACK_UNDERFLOW,     // 00EE with nothing on the stack.
+  STACK_OVERFLOW,      // 2nnn with all STACK_LEVELS in use.
+  MEMORY_RANGE,        // Dxyn, Fx33, Fx55 or Fx65 reaching past 0xFFF via I.
+  PC_RANGE,            // Instruction fetch past 0xFFF (e.g. Bnnn + V0).
+  KEY_RANGE,           // Ex9E or ExA1 with Vx above 0xF.
+};
+
+// What the machine does about a fault.
+enum class FaultPolicy : uint8_t {
+  // Carry on with a safe stand-in (see each instruction) and record nothing.
+  IGNORE,
+  // Same, but record it: the first fault is kept, later ones only counted.
+  TRAP,
+  // Record it and stop: pc stays on the faulting instruction and nothing
+  // runs any more.
+  HALT,
+};
+
+struct FaultInfo {
+  Fault fault;
+  uint16_t pc;      // Address of the faulting instruction.
+  uint16_t opcode;
+  uint64_t cycle;   // Instructions completed before it, see CycleCount().
+};
+
+// "unknown opcode", "stack underflow", ...
+char const *FaultName(Fault fault);
+
+// Parse "ignore", "trap" or "halt". Returns false for anything else.
+bool ParseFaultPolicy(char const *name, FaultPolicy &policy);
+
 class Chip8 {
  public:
   Chip8();
   void Cycle();
   void LoadROM(char const *filename);
 
+  // Same, from a ROM image already in memory (e.g. in a RomLibrary index).
+  // Anything that doesn't fit above 0x200 is left out.
+  void LoadROM(uint8_t const *data, size_t size);
+
+  // True while the sound timer is running, i.e. the beeper should sound.
+  bool SoundOn() const;
+
+  // Pick the interpreter variant the ROM was written for. This swaps the
+  // quirk-dependent entries of the dispatch tables, so call it any time
+  // before running (CHIP8 by default).
+  void SetVariant(Variant variant);
+  Variant GetVariant() const;
+
+  // Use ahead-of-time translated code for this ROM (see tools/chip8recomp).
+  // Returns false, and changes nothing, if "rom" was generated from a
+  // different program or for a different variant. Call after LoadROM().
+  bool AttachRecompiled(RecompiledRom const *rom);
+
+  // Run one recompiled block if one starts at pc, otherwise one Cycle().
+  // Returns the number of instructions executed (0 once halted). Once the
+  // program writes into its own code, the translation is dropped for good.
+  unsigned int Step();
+
+  // ========== Batched stepping ==========
+  // These keep the instruction loop inside the library, so callers pay one
+  // call per batch instead of one per instruction.
+
+  // Run "count" instructions, or fewer if a fault halts the machine.
+  // Returns the number run.
+  unsigned long RunCycles(unsigned long count);
+
+  // Run "count" frames of SetCyclesPerFrame() instructions each.
+  // Returns the number of instructions executed.
+  unsigned long RunFrames(unsigned long count);
+
+  // The chip8emu front end presents after every cycle, so a frame is one
+  // cycle unless set otherwise.
+  void SetCyclesPerFrame(unsigned int cycles);
+
+  // Like RunCycles(), but return early once the program can't get anywhere
+  // until a key is pressed or the delay timer runs out, instead of spinning
+  // on it; Waiting() then says which. Returns the number of instructions
+  // executed. Used by the coroutine scheduler (see scheduler.hpp) to park
+  // waiting machines.
+  unsigned long RunUntilWait(unsigned long count);
+  WaitReason Waiting() const;
+
+  // Like RunCycles(), but interpreted one instruction at a time, marking
+  // each one's address and the edge to the next in "coverage" (see
+  // coverage.hpp). For fuzzing.
+  unsigned long RunCyclesCovered(unsigned long count, Coverage &coverage);
+
+  // The timers tick once per instruction by default, so they follow
+  // emulated time at any speed. With external timers, instructions leave
+  // them alone and the caller calls TickTimers() at 60 Hz instead, which
+  // keeps their rate right when the number of instructions per second
+  // changes (see Governor).
+  void SetExternalTimers(bool external);
+  void TickTimers();
+
+  // Keys are 0x0 to 0xF.
+  void SetKey(uint8_t key, bool pressed);
+
+  // ========== Faults ==========
+  // Checked on paths the compiler is told are unlikely, so well-behaved
+  // programs pay one predictable branch per check. IGNORE by default.
+  void SetFaultPolicy(FaultPolicy policy);
+
+  // The first recorded fault (Fault::NONE if there was none) and how many
+  // there have been, under TRAP or HALT.
+  FaultInfo FirstFault() const;
+  uint32_t FaultCount() const;
+
+  // True once a fault has stopped the machine under HALT. Cycle() and
+  // Step() then do nothing, and the batched runners return early.
+  bool Halted() const;
+
+  // Instructions run so far. Recompiled blocks add theirs when they finish,
+  // so a fault inside one is stamped with the count at the block's start.
+  uint64_t CycleCount() const;
+
+  // ========== Display ==========
+  // PX_WIDTH x PX_HEIGHT, or HIRES_WIDTH x HIRES_HEIGHT after 00FF (SUPER-CHIP
+  // and XO-CHIP only) until 00FE.
+  bool HiRes() const;
+  unsigned int DisplayWidth() const;
+  unsigned int DisplayHeight() const;
+
+  // The display itself, not a copy: DisplayHeight() rows of DISPLAY_WORDS
+  // words each (see DISPLAY_WORDS), of which only the first DisplayWidth()
+  // pixels are used. Valid as long as this Chip8 is.
+  uint64_t const *DisplayRows() const;
+
+  // The display as PX_WIDTH * PX_HEIGHT pixels, row by row, 0xFFFFFFFF = on,
+  // for consumers with a fixed lo-res format. Expanded from DisplayRows()
+  // when they changed since the last call; in hi-res each pixel is on if any
+  // of the 2x2 it stands for is. Valid until the next instruction runs.
+  uint32_t const *Video() const;
+
+  // Read-only views of the machine state, also without copying.
+  uint8_t const *Memory() const;     // MEM_SIZE bytes
+  uint8_t const *Registers() const;  // V0 to VF
+  uint16_t Pc() const;
+  uint16_t Index() const;
+  uint8_t DelayTimer() const;
+  uint8_t SoundTimer() const;
+  uint16_t const *Stack() const;  // STACK_LEVELS entries, StackDepth() used
+  uint8_t StackDepth() const;
+
+  // Restart the random number generator (Cxkk) from "seed", for
+  // reproducible runs.
+  void Seed(uint32_t seed);
+
   uint8_t keypad[KEY_COUNT]{};
-  uint32_t video[PX_WIDTH * PX_HEIGHT]{};
 
  private:
+  friend struct Chip8Access;
+  friend class Snapshot;
+
   // Function Pointer Table instead of switch statements.
 
   // These 4 are dispatch functions,
@@ -34,45 +217,45 @@ class Chip8 {
   // 16 units array
   // from instructions that starts with $0 to $F(inclusive so +1).
   Chip8Func table[0xF + 1] = {
-      &Chip8::Table0,   // 0x0
-      &Chip8::OP_1nnn,  // 0x1
-      &Chip8::OP_2nnn,  // 0x2
-      &Chip8::OP_3xkk,  // 0x3
-      &Chip8::OP_4xkk,  // 0x4
-      &Chip8::OP_5xy0,  // 0x5
-      &Chip8::OP_6xkk,  // 0x6
-      &Chip8::OP_7xkk,  // 0x7
-      &Chip8::Table8,   // 0x8
-      &Chip8::OP_9xy0,  // 0x9
-      &Chip8::OP_Annn,  // 0xA
-      &Chip8::OP_Bnnn,  // 0xB
-      &Chip8::OP_Cxkk,  // 0xC
-      &Chip8::OP_Dxyn,  // 0xD
-      &Chip8::TableE,   // 0xE
-      &Chip8::TableF    // 0xF
+      &Chip8::Table0,                // 0x0
+      &Chip8::OP_1nnn,               // 0x1
+      &Chip8::OP_2nnn,               // 0x2
+      &Chip8::OP_3xkk,               // 0x3
+      &Chip8::OP_4xkk,               // 0x4
+      &Chip8::OP_5xy0,               // 0x5
+      &Chip8::OP_6xkk,               // 0x6
+      &Chip8::OP_7xkk,               // 0x7
+      &Chip8::Table8,                // 0x8
+      &Chip8::OP_9xy0,               // 0x9
+      &Chip8::OP_Annn,               // 0xA
+      &Chip8::OP_Bnnn<Chip8Quirks>,  // 0xB
+      &Chip8::OP_Cxkk,               // 0xC
+      &Chip8::OP_Dxyn<Chip8Quirks>,  // 0xD
+      &Chip8::TableE,                // 0xE
+      &Chip8::TableF                 // 0xF
   };
-  // 15 units array.
-  // for $00E0 & $00EE, only the fourth digit is unique,
-  // therefore, 0x000E + 1 (inclusive of $00EE).
-  Chip8Func table0[0xE + 1] = {};
+  // 256 units array.
+  // for $00E0, $00EE and the SUPER-CHIP $00Cn and $00FB-$00FF, the last 2
+  // digits are unique, and they index the table (opcode & 0xFF), so every
+  // value of them needs an entry.
+  Chip8Func table0[0xFF + 1] = {};
 
-  // 15 units array.
+  // 16 units array.
   // for those starts with $8xy, only the fourth digit is unique,
   // same principle as above, instructions goes to $8xyE.
-  // therefore, 0x000E + 1 (inclusive of $8xyE).
-  Chip8Func table8[0xE + 1] = {};
+  Chip8Func table8[0xF + 1] = {};
 
-  // 15 units array.
+  // 16 units array.
   // for $Exa1 & $Ex9E, although last 2 digits are different,
   // these are the only 2 instructions that need to be dealt with.
-  // So a table from 0x0 to 0xE + 1 is enough.
-  Chip8Func tableE[0xE + 1] = {};
+  // So a table indexed by the last digit is enough.
+  Chip8Func tableE[0xF + 1] = {};
 
-  // 106 units array.
+  // 256 units array.
   // for those that start with $F and last 2 digits are unique.
-  // $Fx goes from $Fx07 to $Fx65.
-  // For the ease of indexing, the array size should be 0x00 to 0x65(inclusive).
-  Chip8Func tableF[0x65 + 1] = {};
+  // $Fx goes from $Fx07 to $Fx65, but any byte can follow $Fx (data run
+  // as code, for one), so every one of them needs an entry.
+  Chip8Func tableF[0xFF + 1] = {};
 
   // In the case of invalid opcodes are called (opcodes that don't exist),
   // it calls OP_NULL.
@@ -85,9 +268,26 @@ class Chip8 {
   void OP_NULL();
 
   // 00E0: CLS (Clear the display).
-  // Set the entire video buffer to zeroes.
+  // Set the entire display to zeroes.
   void OP_00E0();
 
+  // 00Cn: SCD n (SUPER-CHIP: scroll down n rows).
+  // Moves every row n rows down as a whole; the top n rows come in blank.
+  void OP_00Cn();
+
+  // 00FB: SCR (SUPER-CHIP: scroll right 4 pixels).
+  // Shifts each row's words right, carrying bits across the word boundary.
+  void OP_00FB();
+
+  // 00FC: SCL (SUPER-CHIP: scroll left 4 pixels).
+  void OP_00FC();
+
+  // 00FE: LOW (SUPER-CHIP: back to PX_WIDTH x PX_HEIGHT, cleared).
+  void OP_00FE();
+
+  // 00FF: HIGH (SUPER-CHIP: HIRES_WIDTH x HIRES_HEIGHT, cleared).
+  void OP_00FF();
+
   // 00EE: RET (Return from a subroutine).
   // The top of the stack has the address of one instruction past the one that
   // called the subroutine, so we can put that back into the PC. Note that this
@@ -146,10 +346,12 @@ class Chip8 {
   // Subtracts Vy from Vx, sets VF to 1 if no borrow (Vx >= Vy).
   void OP_8xy5();
 
-  // 8xy6: SHR Vx.
+  // 8xy6: SHR Vx {, Vy}.
   // If the least-significant bit of Vx is 1,
   // then VF is set to 1, otherwise 0.
   // Then Vx is divided by 2.
+  // Quirk: CHIP-8 and XO-CHIP shift Vy into Vx instead.
+  template <typename Quirks>
   void OP_8xy6();
 
   // 8xy7: SUBN Vx, Vy.
@@ -160,6 +362,8 @@ class Chip8 {
 
   // 8xyE: SHL Vx {, Vy}.
   // Vx left shift 1, most significant bit is saved in register VF.
+  // Quirk: CHIP-8 and XO-CHIP shift Vy into Vx instead.
+  template <typename Quirks>
   void OP_8xyE();
 
   // 9xy0: SNE Vx, Vy.
@@ -172,6 +376,8 @@ class Chip8 {
 
   // Bnnn: JP V0, addr.
   // Jumps to nnn + V0.
+  // Quirk: SUPER-CHIP reads it as Bxnn, jumping to xnn + Vx.
+  template <typename Quirks>
   void OP_Bnnn();
 
   // Cxkk: RND Vx, byte.
@@ -181,6 +387,10 @@ class Chip8 {
   // Dxyn: DRW Vx, Vy, nibble.
   // Draws an N-byte sprite from memory (at I(Index)) onto the screen at (Vx,
   // Vy). VF = 1 if pixels collide.
+  // Quirk: XO-CHIP wraps sprites around the screen edges, the others clip.
+  // Quirk: SUPER-CHIP and XO-CHIP read Dxy0 as a 16x16 sprite (32 bytes, two
+  // per row).
+  template <typename Quirks>
   void OP_Dxyn();
 
   // Ex9E: SKP Vx.
@@ -215,18 +425,30 @@ class Chip8 {
   // Sets I(Index) to the address of a sprite (0-9) for Vx.
   void OP_Fx29();
 
+  // Fx30: LD HF, Vx (SUPER-CHIP).
+  // Sets I(Index) to the address of a large 8x10 sprite (0-9) for Vx.
+  void OP_Fx30();
+
   // Fx33: LD B, Vx.
   // Stores Vx as 3 digits (hundreds, tens, units) at I, I+1, I+2.
   void OP_Fx33();
 
   // Fx55: LD[I], Vx.
   // Copies V0 to Vx into memory starting at I.
+  // Quirk: CHIP-8 and XO-CHIP leave I at I + x + 1 afterwards.
+  template <typename Quirks>
   void OP_Fx55();
 
   // Fx65: LD Vx, [I].
   // Loads V0 to Vx from memory starting at I.
+  // Quirk: CHIP-8 and XO-CHIP leave I at I + x + 1 afterwards.
+  template <typename Quirks>
   void OP_Fx65();
 
+  // Point the quirk-dependent table entries at one policy's instantiations.
+  template <typename Quirks>
+  void InstallQuirks();
+
   // 16x 8-bit registers, from V0 to VF, holds 0x00 to 0xFF.
   // Denoted as Vx in comments.
   uint8_t registers[REGISTER_COUNT]{};
@@ -262,8 +484,49 @@ class Chip8 {
 
   uint8_t soundTimer{};
 
+  // Packed rows, see DISPLAY_WORDS. Lo-res only uses the first PX_HEIGHT
+  // rows and the first word of each; the rest stays zero.
+  uint64_t display[HIRES_HEIGHT][DISPLAY_WORDS]{};
+  bool hires{};
+
+  // Video() expands into this on demand.
+  mutable uint32_t video[PX_WIDTH * PX_HEIGHT]{};
+  mutable bool videoStale{};
+
   uint16_t opcode{};
 
+  Variant variant = Variant::CHIP8;
+
+  unsigned int cyclesPerFrame = 1;
+  bool externalTimers{};
+
+  // Set by Fx0A and Fx07, cleared by RunUntilWait().
+  WaitReason wait = WaitReason::NONE;
+
+  uint64_t cycleCount{};
+  FaultPolicy faultPolicy = FaultPolicy::IGNORE;
+  FaultInfo firstFault{};
+  uint32_t faultCount{};
+  bool halted{};
+
+  // Handle "fault" raised by the instruction at "address". Returns true if
+  // the machine halted, in which case the instruction must stop at once,
+  // without side effects.
+  bool RaiseFault(Fault fault, uint16_t address);
+
+  // ========== Recompiled code ==========
+  // recompiledBlocks[address]: the block starting at that address, if any.
+  // isCode[address]: that byte belongs to a translated block.
+  // [codeStart, codeEnd) bounds the translated code; codeEnd == 0 means there
+  // is none (never attached, or dropped after a write into it).
+  std::vector<RecompiledFunc> recompiledBlocks;
+  std::vector<bool> isCode;
+  uint16_t codeStart{};
+  uint16_t codeEnd{};
+
+  // Called before the program writes memory[address, address + size).
+  void CheckCodeWrite(unsigned int address, unsigned int size);
+
   // Random Number Generation
   std::default_random_engine randGen;
   std::uniform_int_distribution<uint8_t> randByte;
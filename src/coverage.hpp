@@ -0,0 +1,74 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+// Guest code coverage as two compact bitmaps, for coverage-guided fuzzing
+// (see fuzz.hpp): one bit per instruction address, and one per edge, i.e.
+// per pair of consecutive instruction addresses, hashed into EDGE_BITS the
+// way AFL does. Edges tell "skip taken" from "skip not taken" and which
+// caller a return went back to, which addresses alone can't.
+//
+// Chip8::RunCyclesCovered() marks into one. At 2.5 KiB it clears and
+// compares in well under a microsecond, so a fresh one per execution is
+// cheap.
+struct Coverage {
+  static const unsigned int PC_BITS = 4096;  // MEM_SIZE
+  static const unsigned int EDGE_BITS = 1u << 14;
+
+  uint64_t pcs[PC_BITS / 64]{};
+  uint64_t edges[EDGE_BITS / 64]{};
+
+  // Addresses are below 0x1000, so "from" shifted past "to" keeps most
+  // pairs apart before the fold into EDGE_BITS.
+  static unsigned int EdgeIndex(uint16_t from, uint16_t to) {
+    unsigned int hash = (static_cast<unsigned int>(from) << 12u) ^ to;
+    return (hash ^ (hash >> 14u)) & (EDGE_BITS - 1);
+  }
+
+  void Mark(uint16_t from, uint16_t to) {
+    unsigned int edge = EdgeIndex(from, to);
+    pcs[(from / 64) % (PC_BITS / 64)] |= uint64_t{1} << (from % 64);
+    edges[edge / 64] |= uint64_t{1} << (edge % 64);
+  }
+
+  void Clear() { std::memset(this, 0, sizeof(*this)); }
+
+  // Bits set here that aren't in "seen".
+  unsigned int CountNew(Coverage const& seen) const {
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < PC_BITS / 64; i++) {
+      count += std::popcount(pcs[i] & ~seen.pcs[i]);
+    }
+    for (unsigned int i = 0; i < EDGE_BITS / 64; i++) {
+      count += std::popcount(edges[i] & ~seen.edges[i]);
+    }
+    return count;
+  }
+
+  void Merge(Coverage const& other) {
+    for (unsigned int i = 0; i < PC_BITS / 64; i++) {
+      pcs[i] |= other.pcs[i];
+    }
+    for (unsigned int i = 0; i < EDGE_BITS / 64; i++) {
+      edges[i] |= other.edges[i];
+    }
+  }
+
+  unsigned int PcCount() const {
+    unsigned int count = 0;
+    for (uint64_t word : pcs) {
+      count += std::popcount(word);
+    }
+    return count;
+  }
+
+  unsigned int EdgeCount() const {
+    unsigned int count = 0;
+    for (uint64_t word : edges) {
+      count += std::popcount(word);
+    }
+    return count;
+  }
+};
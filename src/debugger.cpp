@@ -0,0 +1,392 @@
+#include "debugger.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+static char const* HELP =
+    "  b <addr>              break when pc reaches addr\n"
+    "  w <addr> [len]        break before memory is read or written\n"
+    "  wr <addr> [len]       break before memory is written (Fx33, Fx55)\n"
+    "  rd <addr> [len]       break before memory is read (Fx65, Dxyn)\n"
+    "  if <reg> <op> <value> break when it becomes true, e.g. if V3 == 0x10\n"
+    "                        reg is V0-VF or I, op is == != < > <= >=\n"
+    "  l                     list breakpoints\n"
+    "  del <n> | del         delete breakpoint n, or all of them\n"
+    "  s [n]                 execute n instructions (default 1)\n"
+    "  c                     continue\n"
+    "  p                     print registers\n"
+    "  x <addr> [len]        dump memory\n"
+    "  q                     quit\n";
+
+// Spelling of Debugger::Compare, in the same order.
+static char const* COMPARE_NAMES[] = {"==", "!=", "<", ">", "<=", ">="};
+
+static bool ParseNumber(std::string const& text, unsigned long& value) {
+  if (text.empty()) {
+    return false;
+  }
+  char* end;
+  value = std::strtoul(text.c_str(), &end, 0);
+  return *end == '\0';
+}
+
+static bool ParseRegister(std::string const& text, uint8_t& reg) {
+  if (text == "I" || text == "i") {
+    reg = 0x10;
+    return true;
+  }
+  if (text.size() == 2 && (text[0] == 'V' || text[0] == 'v')) {
+    char* end;
+    unsigned long n = std::strtoul(text.c_str() + 1, &end, 16);
+    if (*end == '\0') {
+      reg = n;
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint16_t Fetch(Chip8 const& chip8, uint16_t address) {
+  uint8_t const* memory = chip8.Memory();
+  return (memory[address % MEM_SIZE] << 8u) | memory[(address + 1) % MEM_SIZE];
+}
+
+Debugger::Debugger(std::ostream& out) : out(out) {}
+
+bool Debugger::Active() const {
+  return stopped || stepsLeft != 0 || !breakpoints.empty();
+}
+
+bool Debugger::Stopped() const { return stopped; }
+
+bool Debugger::QuitRequested() const { return quit; }
+
+void Debugger::Stop(Chip8& chip8, char const* reason) {
+  stopped = true;
+  stepsLeft = 0;
+  out << reason << "\n";
+  PrintState(chip8);
+}
+
+void Debugger::Resume(Chip8 const& chip8, unsigned long steps) {
+  // Conditions that already hold shouldn't fire straight away.
+  CheckConditions(chip8, false);
+
+  stopped = false;
+  stepsLeft = steps;
+  skipOnce = true;
+}
+
+unsigned int Debugger::Cycle(Chip8& chip8) {
+  if (stopped) {
+    return 0;
+  }
+
+  if (!skipOnce) {
+    if (Breakpoint const* bp = Hit(chip8)) {
+      stopped = true;
+      stepsLeft = 0;
+      out << "Breakpoint " << (bp - breakpoints.data()) << "\n";
+      PrintState(chip8);
+      return 0;
+    }
+  }
+  skipOnce = false;
+
+  chip8.Cycle();
+
+  if (CheckConditions(chip8)) {
+    return 1;
+  }
+
+  if (stepsLeft != 0 && --stepsLeft == 0) {
+    stopped = true;
+    PrintState(chip8);
+  }
+  return 1;
+}
+
+Debugger::Breakpoint const* Debugger::Hit(Chip8 const& chip8) const {
+  uint16_t pc = chip8.Pc();
+  uint16_t opcode = Fetch(chip8, pc);
+  uint16_t index = chip8.Index();
+  unsigned int x = (opcode & 0x0F00u) >> 8u;
+
+  // The memory range the next instruction will touch, if any.
+  unsigned int first = 0;
+  unsigned int last = 0;
+  bool reads = false;
+  bool writes = false;
+
+  if ((opcode & 0xF0FFu) == 0xF055u) {
+    writes = true;
+    first = index;
+    last = index + x + 1;
+  } else if ((opcode & 0xF0FFu) == 0xF033u) {
+    writes = true;
+    first = index;
+    last = index + 3;
+  } else if ((opcode & 0xF0FFu) == 0xF065u) {
+    reads = true;
+    first = index;
+    last = index + x + 1;
+  } else if ((opcode & 0xF000u) == 0xD000u) {
+    reads = true;
+    first = index;
+    last = index + (opcode & 0x000Fu);
+    // Dxy0: a 16x16 sprite, two bytes per row.
+    if ((opcode & 0x000Fu) == 0 && chip8.GetVariant() != Variant::CHIP8) {
+      last = index + 32;
+    }
+  }
+
+  for (Breakpoint const& bp : breakpoints) {
+    bool overlaps = first < bp.end && bp.start < last;
+
+    switch (bp.kind) {
+      case Kind::PC:
+        if (bp.start == pc) {
+          return &bp;
+        }
+        break;
+      case Kind::READ:
+        if (reads && overlaps) {
+          return &bp;
+        }
+        break;
+      case Kind::WRITE:
+        if (writes && overlaps) {
+          return &bp;
+        }
+        break;
+      case Kind::ACCESS:
+        if ((reads || writes) && overlaps) {
+          return &bp;
+        }
+        break;
+      case Kind::CONDITION:
+        break;
+    }
+  }
+
+  return nullptr;
+}
+
+bool Debugger::CheckConditions(Chip8 const& chip8, bool canFire) {
+  bool fired = false;
+
+  for (size_t i = 0; i < breakpoints.size(); i++) {
+    Breakpoint& bp = breakpoints[i];
+    if (bp.kind != Kind::CONDITION) {
+      continue;
+    }
+
+    unsigned int value =
+        bp.reg == 0x10 ? chip8.Index() : chip8.Registers()[bp.reg];
+    bool isTrue = false;
+    switch (bp.compare) {
+      case Compare::EQ:
+        isTrue = value == bp.value;
+        break;
+      case Compare::NE:
+        isTrue = value != bp.value;
+        break;
+      case Compare::LT:
+        isTrue = value < bp.value;
+        break;
+      case Compare::GT:
+        isTrue = value > bp.value;
+        break;
+      case Compare::LE:
+        isTrue = value <= bp.value;
+        break;
+      case Compare::GE:
+        isTrue = value >= bp.value;
+        break;
+    }
+
+    if (canFire && isTrue && !bp.wasTrue && !fired) {
+      fired = true;
+      stopped = true;
+      stepsLeft = 0;
+      out << "Breakpoint " << i << " (condition)\n";
+      PrintState(chip8);
+    }
+    bp.wasTrue = isTrue;
+  }
+
+  return fired;
+}
+
+void Debugger::PrintState(Chip8 const& chip8) const {
+  char line[160];
+  uint8_t const* V = chip8.Registers();
+
+  std::snprintf(line, sizeof(line),
+                "pc=%03X [%04X]  I=%03X  DT=%02X ST=%02X  sp=%u",
+                chip8.Pc(), Fetch(chip8, chip8.Pc()), chip8.Index(),
+                chip8.DelayTimer(), chip8.SoundTimer(), chip8.StackDepth());
+  out << line;
+  for (uint8_t i = 0; i < chip8.StackDepth() && i < STACK_LEVELS; i++) {
+    std::snprintf(line, sizeof(line), " %03X", chip8.Stack()[i]);
+    out << line;
+  }
+  out << "\n";
+
+  for (unsigned int i = 0; i < REGISTER_COUNT; i++) {
+    std::snprintf(line, sizeof(line), "V%X=%02X%s", i, V[i],
+                  i + 1 == REGISTER_COUNT ? "\n" : " ");
+    out << line;
+  }
+  out.flush();
+}
+
+void Debugger::PrintBreakpoint(size_t number, Breakpoint const& bp) const {
+  char line[96];
+
+  switch (bp.kind) {
+    case Kind::PC:
+      std::snprintf(line, sizeof(line), "%zu: pc == %03X", number, bp.start);
+      break;
+    case Kind::CONDITION:
+      if (bp.reg == 0x10) {
+        std::snprintf(line, sizeof(line), "%zu: I %s %X", number,
+                      COMPARE_NAMES[static_cast<int>(bp.compare)], bp.value);
+      } else {
+        std::snprintf(line, sizeof(line), "%zu: V%X %s %X", number, bp.reg,
+                      COMPARE_NAMES[static_cast<int>(bp.compare)], bp.value);
+      }
+      break;
+    default:
+      std::snprintf(line, sizeof(line), "%zu: %s %03X-%03X", number,
+                    bp.kind == Kind::READ    ? "read"
+                    : bp.kind == Kind::WRITE ? "write"
+                                             : "access",
+                    bp.start, bp.end - 1);
+      break;
+  }
+
+  out << line << "\n";
+}
+
+void Debugger::Command(Chip8& chip8, std::string const& line) {
+  std::istringstream words(line);
+  std::string command;
+  std::vector<std::string> args;
+  words >> command;
+  for (std::string arg; words >> arg;) {
+    args.push_back(arg);
+  }
+
+  if (command.empty()) {
+    return;
+  }
+
+  unsigned long a = 0;
+  unsigned long b = 1;
+  bool hasA = !args.empty() && ParseNumber(args[0], a);
+  bool hasB = args.size() < 2 || ParseNumber(args[1], b);
+
+  if (command == "b" && hasA) {
+    Breakpoint bp;
+    bp.start = a % MEM_SIZE;
+    breakpoints.push_back(bp);
+    PrintBreakpoint(breakpoints.size() - 1, breakpoints.back());
+  } else if ((command == "w" || command == "wr" || command == "rd") && hasA &&
+             hasB && b > 0) {
+    Breakpoint bp;
+    bp.kind = command == "w"    ? Kind::ACCESS
+              : command == "wr" ? Kind::WRITE
+                                : Kind::READ;
+    bp.start = a % MEM_SIZE;
+    bp.end = std::min(a % MEM_SIZE + b, 0xFFFFul);
+    breakpoints.push_back(bp);
+    PrintBreakpoint(breakpoints.size() - 1, breakpoints.back());
+  } else if (command == "if" && args.size() == 3) {
+    Breakpoint bp;
+    bp.kind = Kind::CONDITION;
+    unsigned long value;
+    int compare = -1;
+    for (int i = 0; i < 6; i++) {
+      if (args[1] == COMPARE_NAMES[i]) {
+        compare = i;
+      }
+    }
+
+    if (!ParseRegister(args[0], bp.reg) || compare < 0 ||
+        !ParseNumber(args[2], value)) {
+      out << "Usage: if <V0-VF|I> <op> <value>\n";
+      return;
+    }
+    bp.compare = static_cast<Compare>(compare);
+    bp.value = value;
+    breakpoints.push_back(bp);
+    CheckConditions(chip8, false);
+    PrintBreakpoint(breakpoints.size() - 1, breakpoints.back());
+  } else if (command == "l") {
+    for (size_t i = 0; i < breakpoints.size(); i++) {
+      PrintBreakpoint(i, breakpoints[i]);
+    }
+  } else if (command == "del") {
+    if (args.empty()) {
+      breakpoints.clear();
+    } else if (hasA && a < breakpoints.size()) {
+      breakpoints.erase(breakpoints.begin() + a);
+    } else {
+      out << "No such breakpoint\n";
+    }
+  } else if (command == "s" && (args.empty() || hasA)) {
+    Resume(chip8, args.empty() ? 1 : a);
+  } else if (command == "c") {
+    Resume(chip8, 0);
+  } else if (command == "p") {
+    PrintState(chip8);
+  } else if (command == "x" && hasA && hasB) {
+    char text[8];
+    for (unsigned long i = 0; i < std::max(b, 1ul); i++) {
+      if (i % 16 == 0) {
+        std::snprintf(text, sizeof(text), "%s%03lX:", i ? "\n" : "",
+                      (a + i) % MEM_SIZE);
+        out << text;
+      }
+      std::snprintf(text, sizeof(text), " %02X",
+                    chip8.Memory()[(a + i) % MEM_SIZE]);
+      out << text;
+    }
+    out << "\n";
+  } else if (command == "q") {
+    quit = true;
+  } else if (command == "help" || command == "h") {
+    out << HELP;
+  } else {
+    out << "Unknown command, try help\n";
+  }
+
+  out.flush();
+}
+
+// ========== Console ==========
+
+DebugConsole::DebugConsole() : queue(std::make_shared<Queue>()) {
+  std::thread([queue = queue] {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      queue->lines.push_back(line);
+    }
+  }).detach();
+}
+
+bool DebugConsole::Poll(std::string& line) {
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  if (queue->lines.empty()) {
+    return false;
+  }
+  line = std::move(queue->lines.front());
+  queue->lines.pop_front();
+  return true;
+}
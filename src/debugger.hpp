@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+
+// Interactive debugger: breakpoints on pc, watchpoints on memory ranges,
+// breaks on register conditions, and single-stepping.
+//
+// It costs nothing while unused. The front end only routes execution through
+// Debugger::Cycle() while Active() is true, i.e. while stopped, stepping, or
+// with at least one breakpoint set. Otherwise the normal loop (including
+// recompiled blocks) runs untouched.
+//
+// Memory accesses are predicted before each instruction from its opcode:
+// Fx55 and Fx33 write at I, Fx65 and Dxyn read at I. So a watchpoint stops
+// the program *before* the access, with pc on the instruction responsible.
+class Debugger {
+ public:
+  explicit Debugger(std::ostream& out);
+
+  // Run one command line. "help" lists the commands.
+  void Command(Chip8& chip8, std::string const& line);
+
+  // Stop before the next instruction, e.g. at startup.
+  void Stop(Chip8& chip8, char const* reason);
+
+  // True if instructions have to go through Cycle() below.
+  bool Active() const;
+
+  // Run one instruction unless a breakpoint fires (or the debugger is
+  // stopped). Returns the number of instructions executed: 1 or 0.
+  unsigned int Cycle(Chip8& chip8);
+
+  // Waiting for a command. Like gdb, commands typed while the program runs
+  // are held until it stops again.
+  bool Stopped() const;
+
+  // The user typed "q".
+  bool QuitRequested() const;
+
+ private:
+  enum class Kind : uint8_t { PC, READ, WRITE, ACCESS, CONDITION };
+  enum class Compare : uint8_t { EQ, NE, LT, GT, LE, GE };
+
+  struct Breakpoint {
+    Kind kind = Kind::PC;
+    uint16_t start{};  // pc, or first watched address
+    uint16_t end{};    // one past the last watched address
+    uint8_t reg{};     // CONDITION: 0x0-0xF = Vx, 0x10 = I
+    Compare compare = Compare::EQ;
+    uint16_t value{};
+    bool wasTrue{};  // CONDITION fires when it *becomes* true
+  };
+
+  // Why the instruction at pc must not run yet, or nullptr.
+  Breakpoint const* Hit(Chip8 const& chip8) const;
+  // Update every condition. Returns true if one became true and stopped
+  // the program.
+  bool CheckConditions(Chip8 const& chip8, bool canFire = true);
+  void PrintState(Chip8 const& chip8) const;
+  void PrintBreakpoint(size_t number, Breakpoint const& bp) const;
+  void Resume(Chip8 const& chip8, unsigned long steps);
+
+  std::ostream& out;
+  std::vector<Breakpoint> breakpoints;
+  bool stopped = false;
+  bool quit = false;
+
+  // Steps left before stopping again, 0 = run freely.
+  unsigned long stepsLeft = 0;
+
+  // Don't break again on the instruction we just resumed from.
+  bool skipOnce = false;
+};
+
+// Reads debugger commands from stdin on a thread of its own, so that the
+// window stays responsive while the program is stopped.
+class DebugConsole {
+ public:
+  DebugConsole();
+
+  // Next line typed, if any. Never blocks.
+  bool Poll(std::string& line);
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::string> lines;
+  };
+
+  // Shared with the reader thread, which is detached (it sits in a blocking
+  // read) and may outlive this object.
+  std::shared_ptr<Queue> queue;
+};
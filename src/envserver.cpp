@@ -0,0 +1,274 @@
+#include "envserver.hpp"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+// How many times to poll before going to sleep in the kernel. A step of a
+// few hundred cycles is short enough that the answer often arrives while
+// still spinning, which saves two context switches.
+const unsigned int SPIN_LIMIT = 4000;
+
+// ========== Futex helpers ==========
+// Not FUTEX_PRIVATE: the words live in memory shared between processes.
+
+static void FutexWait(std::atomic<uint32_t>& word, uint32_t expected) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected,
+          nullptr, nullptr, 0);
+}
+
+static void FutexWakeAll(std::atomic<uint32_t>& word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+}
+
+// Wait until "word" no longer holds "old". Returns the new value.
+static uint32_t WaitForChange(std::atomic<uint32_t>& word, uint32_t old) {
+  for (unsigned int i = 0; i < SPIN_LIMIT; i++) {
+    uint32_t value = word.load(std::memory_order_acquire);
+    if (value != old) {
+      return value;
+    }
+  }
+
+  uint32_t value;
+  while ((value = word.load(std::memory_order_acquire)) == old) {
+    FutexWait(word, old);
+  }
+  return value;
+}
+
+static size_t ShmSize(unsigned int envCount) {
+  // Slots start on their own cache line after the header.
+  size_t headerSize = (sizeof(EnvShmHeader) + 63) & ~size_t(63);
+  return headerSize + envCount * sizeof(EnvSlot);
+}
+
+static EnvSlot* FirstSlot(EnvShmHeader* header) {
+  size_t headerSize = (sizeof(EnvShmHeader) + 63) & ~size_t(63);
+  return reinterpret_cast<EnvSlot*>(reinterpret_cast<char*>(header) +
+                                    headerSize);
+}
+
+// =============================
+// ========== Server ==========
+// =============================
+
+EnvServer::EnvServer(char const* romFilename, Variant variant,
+                     std::string const& name, unsigned int envCount,
+                     unsigned int threadCount, unsigned int cyclesPerStep,
+                     std::vector<uint16_t> const& probes)
+    : name(name), cyclesPerStep(cyclesPerStep), threadCount(threadCount) {
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+  if (fd < 0) {
+    return;
+  }
+
+  mappedSize = ShmSize(envCount);
+  if (ftruncate(fd, mappedSize) != 0) {
+    close(fd);
+    return;
+  }
+
+  void* memory =
+      mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return;
+  }
+
+  // ftruncate zero-fills, which is a valid starting state for the atomics.
+  header = static_cast<EnvShmHeader*>(memory);
+  slots = FirstSlot(header);
+
+  header->envCount = envCount;
+  header->probeCount = std::min<size_t>(probes.size(), ENV_MAX_PROBES);
+  header->cyclesPerStep = cyclesPerStep;
+  header->slotSize = sizeof(EnvSlot);
+  for (unsigned int i = 0; i < header->probeCount; i++) {
+    header->probeAddress[i] = probes[i] % MEM_SIZE;
+  }
+
+  pristine.LoadROM(romFilename);
+  pristine.SetVariant(variant);
+  // An episode that faults can't teach anything more; stop spending cycles
+  // on it and let the client see why (EnvSlot::fault).
+  pristine.SetFaultPolicy(FaultPolicy::HALT);
+  envs.assign(envCount, pristine);
+  episodes.assign(envCount, 0);
+
+  for (unsigned int i = 0; i < envCount; i++) {
+    // Different random streams, but reproducible from run to run.
+    envs[i].Seed(i);
+    Publish(i);
+  }
+
+  // Clients check the magic last, so they never see a half-built header.
+  header->version = ENV_SHM_VERSION;
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = ENV_SHM_MAGIC;
+
+  threadCount = std::max(1u, std::min(threadCount, envCount));
+  this->threadCount = threadCount;
+  pending.store(threadCount);
+
+  for (unsigned int t = 0; t < threadCount; t++) {
+    unsigned int first = envCount * t / threadCount;
+    unsigned int last = envCount * (t + 1) / threadCount;
+    workers.emplace_back(&EnvServer::Worker, this, first, last);
+  }
+}
+
+EnvServer::~EnvServer() {
+  if (!header) {
+    return;
+  }
+
+  header->shutdown.store(1);
+  header->requestSeq.fetch_add(1, std::memory_order_release);
+  FutexWakeAll(header->requestSeq);
+  Wait();
+
+  munmap(header, mappedSize);
+  shm_unlink(name.c_str());
+}
+
+bool EnvServer::Ok() const { return header != nullptr; }
+
+void EnvServer::Wait() {
+  for (std::thread& worker : workers) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
+
+uint32_t EnvServer::StepsServed() const {
+  return header ? header->doneSeq.load() : 0;
+}
+
+void EnvServer::Worker(unsigned int first, unsigned int last) {
+  // Not loaded from requestSeq: a client may already have asked for the
+  // first step before this thread got going. The object starts zeroed.
+  uint32_t seen = 0;
+
+  while (true) {
+    seen = WaitForChange(header->requestSeq, seen);
+    if (header->shutdown.load()) {
+      return;
+    }
+
+    for (unsigned int i = first; i < last; i++) {
+      StepEnv(i);
+    }
+
+    // Last worker out publishes the step and re-arms the counter for the
+    // next one. No request can arrive before doneSeq is published.
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      pending.store(threadCount, std::memory_order_relaxed);
+      header->doneSeq.store(seen, std::memory_order_release);
+      FutexWakeAll(header->doneSeq);
+    }
+  }
+}
+
+void EnvServer::StepEnv(unsigned int i) {
+  EnvSlot& slot = slots[i];
+  Chip8& env = envs[i];
+
+  if (slot.reset) {
+    // New episode, new random stream (still reproducible, and distinct for
+    // every env and episode).
+    env = pristine;
+    env.Seed(i + envs.size() * ++episodes[i]);
+    slot.episodeSteps = 0;
+    slot.reset = 0;
+  }
+
+  for (uint8_t key = 0; key < KEY_COUNT; key++) {
+    env.SetKey(key, slot.keys & (1u << key));
+  }
+
+  env.RunCycles(cyclesPerStep);
+  slot.episodeSteps++;
+  Publish(i);
+}
+
+void EnvServer::Publish(unsigned int i) {
+  EnvSlot& slot = slots[i];
+  Chip8 const& env = envs[i];
+
+  slot.pc = env.Pc();
+  slot.fault = static_cast<uint8_t>(env.FirstFault().fault);
+  std::memcpy(slot.registers, env.Registers(), sizeof(slot.registers));
+  for (unsigned int p = 0; p < header->probeCount; p++) {
+    slot.probes[p] = env.Memory()[header->probeAddress[p]];
+  }
+  std::memcpy(slot.video, env.Video(), sizeof(slot.video));
+}
+
+// =============================
+// ========== Client ==========
+// =============================
+
+EnvClient::EnvClient(std::string const& name) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    return;
+  }
+
+  EnvShmHeader probe;
+  if (pread(fd, &probe, sizeof(probe), 0) != sizeof(probe) ||
+      probe.magic != ENV_SHM_MAGIC || probe.version != ENV_SHM_VERSION ||
+      probe.slotSize != sizeof(EnvSlot)) {
+    close(fd);
+    return;
+  }
+
+  mappedSize = ShmSize(probe.envCount);
+  void* memory =
+      mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    return;
+  }
+
+  header = static_cast<EnvShmHeader*>(memory);
+  slots = FirstSlot(header);
+}
+
+EnvClient::~EnvClient() {
+  if (header) {
+    munmap(header, mappedSize);
+  }
+}
+
+bool EnvClient::Ok() const { return header != nullptr; }
+
+unsigned int EnvClient::EnvCount() const { return header->envCount; }
+
+EnvSlot& EnvClient::Slot(unsigned int i) { return slots[i]; }
+
+void EnvClient::Step() {
+  // Release: the inputs written into the slots go out with the request.
+  uint32_t seq =
+      header->requestSeq.fetch_add(1, std::memory_order_release) + 1;
+  FutexWakeAll(header->requestSeq);
+
+  uint32_t done = header->doneSeq.load(std::memory_order_acquire);
+  while (done != seq) {
+    done = WaitForChange(header->doneSeq, done);
+  }
+}
+
+void EnvClient::Shutdown() {
+  header->shutdown.store(1);
+  header->requestSeq.fetch_add(1, std::memory_order_release);
+  FutexWakeAll(header->requestSeq);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+
+// Vectorised environments for reinforcement learning, shared through POSIX
+// shared memory (Linux only, it uses futexes).
+//
+// A server process hosts N Chip8 instances. Everything a client needs sits
+// in one shared-memory object: a header, then one slot per environment
+// holding its inputs (keys, reset) and its observations (framebuffer,
+// registers, probed RAM bytes). A client writes inputs straight into the
+// slots, bumps "requestSeq" and waits for "doneSeq" to catch up. Then it
+// reads observations straight out of the slots. Nothing is copied through a
+// socket or pipe.
+//
+// Both sequence counters double as futex words, so an idle side sleeps in
+// the kernel rather than spinning, and a step costs one wake each way.
+
+const uint32_t ENV_SHM_MAGIC = 0x38504843;  // "CHP8"
+const uint32_t ENV_SHM_VERSION = 1;
+const unsigned int ENV_MAX_PROBES = 16;
+
+struct EnvShmHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t envCount;
+  uint32_t probeCount;
+  uint32_t cyclesPerStep;
+  uint32_t slotSize;  // sizeof(EnvSlot), for clients in other languages.
+  uint16_t probeAddress[ENV_MAX_PROBES];
+
+  // Client -> server: increment to request a step of every environment.
+  alignas(64) std::atomic<uint32_t> requestSeq;
+  // Server -> client: set to requestSeq once all environments have stepped.
+  alignas(64) std::atomic<uint32_t> doneSeq;
+  // Client -> server: set to 1 (then bump requestSeq) to stop the server.
+  std::atomic<uint32_t> shutdown;
+};
+
+// One environment. Cache-line aligned so workers on different cores don't
+// share lines.
+struct alignas(64) EnvSlot {
+  // ========== Written by the client before a step ==========
+  uint16_t keys;  // Bit k set = key k held.
+  uint8_t reset;  // 1 = restart the ROM before this step. Cleared by server.
+
+  // ========== Written by the server during a step ==========
+  // Fault (a Fault value) that halted this environment, 0 if none. A halted
+  // environment stays as it is until the client resets it.
+  uint8_t fault;
+  uint32_t episodeSteps;
+  uint16_t pc;
+  uint8_t registers[REGISTER_COUNT];
+  uint8_t probes[ENV_MAX_PROBES];  // memory[probeAddress[i]]
+  uint32_t video[PX_WIDTH * PX_HEIGHT];  // Chip8::Video()
+};
+
+class EnvServer {
+ public:
+  // Creates (or replaces) the shared-memory object "name" (e.g. "/chip8env")
+  // and starts "threadCount" workers, each owning a slice of the
+  // environments.
+  EnvServer(char const* romFilename, Variant variant, std::string const& name,
+            unsigned int envCount, unsigned int threadCount,
+            unsigned int cyclesPerStep, std::vector<uint16_t> const& probes);
+
+  // Stops the workers and removes the shared-memory object.
+  ~EnvServer();
+
+  // False if the shared-memory object couldn't be set up.
+  bool Ok() const;
+
+  // Block until a client asks the server to shut down.
+  void Wait();
+
+  // Steps served so far (each one steps every environment).
+  uint32_t StepsServed() const;
+
+ private:
+  void Worker(unsigned int first, unsigned int last);
+  void StepEnv(unsigned int i);
+  void Publish(unsigned int i);
+
+  std::string name;
+  EnvShmHeader* header{};
+  EnvSlot* slots{};
+  size_t mappedSize{};
+
+  Chip8 pristine;
+  std::vector<Chip8> envs;
+  std::vector<uint32_t> episodes;  // Resets so far, per environment.
+  unsigned int cyclesPerStep;
+
+  // Workers still busy with the current step. The last one to finish
+  // publishes doneSeq.
+  std::atomic<unsigned int> pending{0};
+  unsigned int threadCount;
+  std::vector<std::thread> workers;
+};
+
+// Client side, for C++ callers (other languages can map the same layout).
+class EnvClient {
+ public:
+  explicit EnvClient(std::string const& name);
+  ~EnvClient();
+
+  bool Ok() const;
+  unsigned int EnvCount() const;
+  EnvSlot& Slot(unsigned int i);
+
+  // Step every environment once with the inputs currently in the slots.
+  void Step();
+
+  // Ask the server to exit.
+  void Shutdown();
+
+ private:
+  EnvShmHeader* header{};
+  EnvSlot* slots{};
+  size_t mappedSize{};
+};
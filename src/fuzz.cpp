@@ -0,0 +1,343 @@
+#include "fuzz.hpp"
+
+#include <algorithm>
+#include <random>
+#include <unordered_set>
+
+// Executions between a worker's catch-ups with the shared corpus and
+// coverage (and between updates of the shared counters).
+static const unsigned int SYNC_INTERVAL = 4096;
+
+// What a soft-lock leaves unchanged. The display and memory are left out:
+// a stuck program doesn't touch them, and hashing them every frame would
+// cost more than the frame.
+static uint64_t Fingerprint(Chip8 const& chip8) {
+  uint64_t hash = 0xCBF29CE484222325ull;
+  auto mix = [&hash](uint64_t value) {
+    hash = (hash ^ value) * 0x100000001B3ull;
+  };
+
+  uint8_t const* registers = chip8.Registers();
+  for (unsigned int i = 0; i < REGISTER_COUNT; i++) {
+    mix(registers[i]);
+  }
+  mix(chip8.Pc());
+  mix(chip8.Index());
+  mix(chip8.StackDepth());
+  mix(chip8.DelayTimer());
+  mix(chip8.SoundTimer());
+  return hash;
+}
+
+static void ApplyKeys(Chip8& chip8, uint16_t keys) {
+  for (uint8_t key = 0; key < KEY_COUNT; key++) {
+    chip8.SetKey(key, (keys >> key) & 1u);
+  }
+}
+
+// Nothing pressed half the time, otherwise one of "keys".
+static uint16_t RandomMask(std::vector<uint8_t> const& keys,
+                           std::mt19937& random) {
+  if (keys.empty() || random() % 2 == 0) {
+    return 0;
+  }
+  return static_cast<uint16_t>(1u << keys[random() % keys.size()]);
+}
+
+// One to four stacked changes, in the spirit of AFL's havoc stage, but on
+// frames of key masks instead of bytes.
+static void Mutate(
+    std::vector<uint16_t>& input,
+    std::vector<std::shared_ptr<std::vector<uint16_t> const>> const& corpus,
+    std::vector<uint8_t> const& keys, unsigned int maxFrames,
+    std::mt19937& random) {
+  unsigned int changes = 1 + random() % 4;
+
+  for (unsigned int i = 0; i < changes; i++) {
+    if (input.empty()) {
+      input.push_back(RandomMask(keys, random));
+    }
+    size_t size = input.size();
+    size_t at = random() % size;
+
+    switch (random() % 6) {
+      case 0:
+        // Press something else in one frame.
+        input[at] = RandomMask(keys, random);
+        break;
+      case 1:
+        // Toggle one key in one frame.
+        if (!keys.empty()) {
+          input[at] ^=
+              static_cast<uint16_t>(1u << keys[random() % keys.size()]);
+        }
+        break;
+      case 2: {
+        // Hold one frame's keys for a while.
+        size_t length = 1 + random() % 8;
+        std::fill(input.begin() + at,
+                  input.begin() + std::min(size, at + length), input[at]);
+        break;
+      }
+      case 3: {
+        // Repeat a run of frames somewhere else.
+        size_t from = random() % size;
+        size_t length = 1 + random() % std::min<size_t>(size, 8);
+        for (size_t j = 0; j < length && from + j < size && at + j < size;
+             j++) {
+          input[at + j] = input[from + j];
+        }
+        break;
+      }
+      case 4: {
+        // Splice: keep this input's start, take another's rest.
+        auto const& other = *corpus[random() % corpus.size()];
+        if (at < other.size()) {
+          input.resize(at);
+          input.insert(input.end(), other.begin() + at, other.end());
+        }
+        break;
+      }
+      default: {
+        // Shorten, or lengthen with random frames.
+        size_t length = 1 + random() % maxFrames;
+        while (input.size() < length) {
+          input.push_back(RandomMask(keys, random));
+        }
+        input.resize(length);
+        break;
+      }
+    }
+  }
+
+  if (input.size() > maxFrames) {
+    input.resize(maxFrames);
+  }
+}
+
+Fuzzer::Fuzzer(Chip8 const& root, FuzzOptions const& options)
+    : options(options), root(root) {
+  this->options.cyclesPerFrame = std::max(1u, options.cyclesPerFrame);
+  this->options.maxFrames = std::max(1u, options.maxFrames);
+  this->options.threads = std::max(1u, options.threads);
+
+  this->root.SetFaultPolicy(FaultPolicy::HALT);
+  start = Snapshot(this->root);
+
+  for (uint8_t key = 0; key < KEY_COUNT; key++) {
+    if ((options.keys >> key) & 1u) {
+      allowedKeys.push_back(key);
+    }
+  }
+
+  // Mutations need something to start from: nothing pressed at all.
+  corpus.push_back(std::make_shared<std::vector<uint16_t> const>(
+      this->options.maxFrames, 0));
+}
+
+Fuzzer::~Fuzzer() { Stop(); }
+
+void Fuzzer::Start() {
+  if (!threads.empty()) {
+    return;
+  }
+  stop = false;
+  for (unsigned int i = 0; i < options.threads; i++) {
+    threads.emplace_back(&Fuzzer::Worker, this, i);
+  }
+}
+
+void Fuzzer::Stop() {
+  stop = true;
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+}
+
+FuzzStats Fuzzer::Stats() {
+  FuzzStats stats;
+  stats.executions = executions;
+  stats.cycles = cycles;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  stats.corpusSize = corpus.size();
+  stats.pcs = total.PcCount();
+  stats.edges = total.EdgeCount();
+  for (FuzzFinding const& finding : findings) {
+    if (finding.kind == FuzzFinding::Kind::CRASH) {
+      stats.crashes++;
+    } else {
+      stats.softLocks++;
+    }
+  }
+  return stats;
+}
+
+std::vector<FuzzFinding> Fuzzer::Findings() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return findings;
+}
+
+Fuzzer::Execution Fuzzer::Execute(Chip8& machine,
+                                  std::vector<uint16_t> const& input,
+                                  Coverage& coverage) const {
+  Execution result;
+  uint64_t lastState = Fingerprint(machine);
+  unsigned int still = 0;
+  bool pressed = false;
+
+  for (uint16_t keys : input) {
+    ApplyKeys(machine, keys);
+    machine.RunCyclesCovered(options.cyclesPerFrame, coverage);
+    result.frames++;
+
+    if (machine.Halted()) {
+      break;
+    }
+    if (options.stallFrames == 0) {
+      continue;
+    }
+
+    uint64_t state = Fingerprint(machine);
+    if (state != lastState) {
+      lastState = state;
+      still = 0;
+      pressed = false;
+      continue;
+    }
+
+    // Standing still is only suspicious while something is being pressed;
+    // otherwise the program may just be waiting for a key.
+    pressed = pressed || keys != 0;
+    if (++still >= options.stallFrames && pressed) {
+      result.stalled = true;
+      break;
+    }
+  }
+
+  return result;
+}
+
+// The execution stalled with some keys; try each one (and none) held on a
+// copy. Rare enough that copying the whole machine doesn't matter.
+bool Fuzzer::StuckForGood(Chip8 const& machine) const {
+  uint64_t state = Fingerprint(machine);
+
+  for (int key = -1; key < static_cast<int>(allowedKeys.size()); key++) {
+    Chip8 probe = machine;
+    ApplyKeys(probe,
+              key < 0 ? 0 : static_cast<uint16_t>(1u << allowedKeys[key]));
+
+    for (unsigned int frame = 0; frame < options.stallFrames; frame++) {
+      probe.RunCycles(options.cyclesPerFrame);
+      if (probe.Halted() || Fingerprint(probe) != state) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void Fuzzer::Record(FuzzFinding finding) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (FuzzFinding const& known : findings) {
+    if (known.kind == finding.kind && known.fault == finding.fault &&
+        known.pc == finding.pc) {
+      return;
+    }
+  }
+  findings.push_back(std::move(finding));
+}
+
+void Fuzzer::Worker(unsigned int worker) {
+  std::mt19937 random(options.seed + worker);
+  Chip8 machine = root;
+  uint64_t startCycles = root.CycleCount();
+
+  Coverage seen;
+  Coverage coverage;
+  std::vector<Input> view;
+  std::vector<uint16_t> input;
+
+  // Findings this worker already reported, as kind, fault and pc, and
+  // stalled states that turned out not to be stuck.
+  std::unordered_set<uint32_t> reported;
+  std::unordered_set<uint64_t> notStuck;
+
+  uint64_t localExecutions = 0;
+  uint64_t localCycles = 0;
+
+  // Under the lock: take the shared coverage and any new corpus entries.
+  auto catchUp = [&] {
+    seen = total;
+    view.insert(view.end(), corpus.begin() + view.size(), corpus.end());
+  };
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    catchUp();
+  }
+
+  while (!stop.load(std::memory_order_relaxed)) {
+    input = *view[random() % view.size()];
+    Mutate(input, view, allowedKeys, options.maxFrames, random);
+
+    start.Restore(machine);
+    coverage.Clear();
+    Execution run = Execute(machine, input, coverage);
+    // Only the frames that ran matter, for the corpus and for findings.
+    input.resize(run.frames);
+
+    localExecutions++;
+    localCycles += machine.CycleCount() - startCycles;
+
+    if (coverage.CountNew(seen) > 0) {
+      std::lock_guard<std::mutex> lock(mutex);
+      // Another worker may have got there first.
+      if (coverage.CountNew(total) > 0) {
+        total.Merge(coverage);
+        corpus.push_back(std::make_shared<std::vector<uint16_t> const>(input));
+      }
+      catchUp();
+    }
+
+    if (machine.Halted()) {
+      FaultInfo fault = machine.FirstFault();
+      uint32_t key = (static_cast<uint32_t>(fault.fault) << 16u) | fault.pc;
+      if (reported.insert(key).second) {
+        Record({FuzzFinding::Kind::CRASH, fault.fault, fault.pc, fault.opcode,
+                fault.cycle - startCycles, input});
+      }
+    } else if (run.stalled) {
+      uint16_t pc = machine.Pc();
+      uint32_t key = (1u << 24u) | pc;
+      uint64_t state = Fingerprint(machine);
+      if (!reported.count(key) && !notStuck.count(state)) {
+        if (StuckForGood(machine)) {
+          reported.insert(key);
+          uint8_t const* memory = machine.Memory();
+          uint16_t opcode = pc + 1u < MEM_SIZE
+                                ? static_cast<uint16_t>((memory[pc] << 8u) |
+                                                        memory[pc + 1])
+                                : 0;
+          Record({FuzzFinding::Kind::SOFT_LOCK, Fault::NONE, pc, opcode,
+                  machine.CycleCount() - startCycles, input});
+        } else {
+          notStuck.insert(state);
+        }
+      }
+    }
+
+    if (localExecutions % SYNC_INTERVAL == 0) {
+      executions += SYNC_INTERVAL;
+      cycles += localCycles;
+      localCycles = 0;
+
+      std::lock_guard<std::mutex> lock(mutex);
+      catchUp();
+    }
+  }
+
+  executions += localExecutions % SYNC_INTERVAL;
+  cycles += localCycles;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+#include "coverage.hpp"
+#include "snapshot.hpp"
+
+// Coverage-guided fuzzing of keypad input, to find crashes and soft-locks.
+//
+// An input is one key mask per frame (bit k = key k held). An execution
+// restores the machine from a Snapshot of its starting state, which is a
+// memcpy of a few pages rather than a new Chip8 and another read of the ROM,
+// then runs the input a frame at a time through Chip8::RunCyclesCovered().
+// Inputs that mark an instruction address or edge no earlier input reached
+// join the corpus, and new inputs are mutations of corpus entries.
+//
+// Findings, each reported once per kind, fault and address:
+//   crash      the program faulted; machines run under FaultPolicy::HALT,
+//              so the execution stops on the faulting instruction
+//   soft-lock  pc, I, the registers and the timers stayed the same for
+//              "stallFrames" frames while keys were being pressed, and
+//              holding any one key (or none) doesn't change them either
+//
+// Every worker thread owns a machine, its own copy of the total coverage
+// and a view of the corpus. The shared state is only locked when an
+// execution looks new to the worker, and every few thousand executions to
+// catch up on what the others found.
+
+struct FuzzOptions {
+  unsigned int cyclesPerFrame = 10;
+  unsigned int maxFrames = 30;    // Longest input.
+  unsigned int stallFrames = 20;  // 0 = don't look for soft-locks.
+  unsigned int threads = 1;
+  uint16_t keys = 0xFFFF;  // Keys inputs may press.
+  uint32_t seed = 1;       // Mutation randomness; worker i uses seed + i.
+};
+
+struct FuzzFinding {
+  enum class Kind : uint8_t { CRASH, SOFT_LOCK };
+
+  Kind kind;
+  Fault fault;  // Fault::NONE for soft-locks.
+  uint16_t pc;  // Faulting instruction, or where the machine is stuck.
+  uint16_t opcode;
+  uint64_t cycle;  // Instructions run before it.
+  std::vector<uint16_t> input;  // Up to the frame it happened in.
+};
+
+struct FuzzStats {
+  uint64_t executions{};
+  uint64_t cycles{};
+  size_t corpusSize{};
+  unsigned int pcs{};
+  unsigned int edges{};
+  size_t crashes{};
+  size_t softLocks{};
+};
+
+class Fuzzer {
+ public:
+  // "root" must be ready to run (ROM loaded, variant set, seeded); every
+  // execution starts from its current state.
+  Fuzzer(Chip8 const& root, FuzzOptions const& options);
+
+  // Stop() if still running.
+  ~Fuzzer();
+
+  Fuzzer(Fuzzer const&) = delete;
+  Fuzzer& operator=(Fuzzer const&) = delete;
+
+  // Start the worker threads, or stop them and wait for them to finish.
+  void Start();
+  void Stop();
+
+  FuzzStats Stats();
+  std::vector<FuzzFinding> Findings();
+
+ private:
+  typedef std::shared_ptr<std::vector<uint16_t> const> Input;
+
+  struct Execution {
+    unsigned int frames{};  // Run before it ended.
+    bool stalled{};
+  };
+
+  void Worker(unsigned int worker);
+  Execution Execute(Chip8& machine, std::vector<uint16_t> const& input,
+                    Coverage& coverage) const;
+  bool StuckForGood(Chip8 const& machine) const;
+  void Record(FuzzFinding finding);
+
+  FuzzOptions options;
+  Chip8 root;
+  Snapshot start;
+  std::vector<uint8_t> allowedKeys;
+
+  std::mutex mutex;
+  Coverage total;
+  std::vector<Input> corpus;
+  std::vector<FuzzFinding> findings;
+
+  std::atomic<uint64_t> executions{};
+  std::atomic<uint64_t> cycles{};
+  std::atomic<bool> stop{};
+  std::vector<std::thread> threads;
+};
@@ -0,0 +1,76 @@
+#include "governor.hpp"
+
+#include <algorithm>
+
+const double FRAME_NS = 1e9 / Governor::FRAME_RATE;
+
+Governor::Governor(GovernorOptions const& options)
+    : options(options) {
+  this->options.targetCyclesPerFrame =
+      std::max(1u, options.targetCyclesPerFrame);
+  cyclesPerFrame =
+      std::min(START_CYCLES_PER_FRAME, this->options.targetCyclesPerFrame);
+}
+
+unsigned int Governor::CyclesPerFrame() const { return cyclesPerFrame; }
+
+unsigned int Governor::PresentInterval() const { return presentInterval; }
+
+double Governor::Load() const { return load; }
+
+void Governor::EndFrame(unsigned int cycles, uint64_t emulationNs,
+                        uint64_t presentNs, bool presented) {
+  frames++;
+  this->cycles += cycles;
+  this->emulationNs += emulationNs;
+  if (presented) {
+    this->presentNs += presentNs;
+    presents++;
+  }
+
+  if (frames >= ADJUST_FRAMES) {
+    Adjust();
+  }
+}
+
+void Governor::Adjust() {
+  load = (emulationNs + presentNs) / (frames * FRAME_NS);
+  if (cycles > 0) {
+    nsPerCycle = static_cast<double>(emulationNs) / cycles;
+  }
+  if (presents > 0) {
+    nsPerPresent = static_cast<double>(presentNs) / presents;
+  }
+
+  frames = 0;
+  cycles = 0;
+  emulationNs = 0;
+  presentNs = 0;
+  presents = 0;
+
+  double budgetNs = options.cpuBudget * FRAME_NS;
+  unsigned int target = options.targetCyclesPerFrame;
+  unsigned int maxInterval = std::max(
+      1u, static_cast<unsigned int>(options.latencyTargetMs * 1e6 / FRAME_NS));
+
+  // Present as often as possible while the target speed still fits.
+  presentInterval = maxInterval;
+  for (unsigned int interval = 1; interval <= maxInterval; interval++) {
+    if (target * nsPerCycle + nsPerPresent / interval <= budgetNs) {
+      presentInterval = interval;
+      break;
+    }
+  }
+
+  double left = budgetNs - nsPerPresent / presentInterval;
+  unsigned int fits =
+      nsPerCycle > 0 ? static_cast<unsigned int>(std::clamp(
+                           left / nsPerCycle, 1.0, static_cast<double>(target)))
+                     : target;
+
+  if (fits < cyclesPerFrame) {
+    cyclesPerFrame = fits;
+  } else {
+    cyclesPerFrame += (fits - cyclesPerFrame + 1) / 2;
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+// Keeps one emulator session within a share of a host core, for hosts that
+// run many sessions at once.
+//
+// The session runs in 60 Hz frames: a batch of instructions, one timer tick
+// (Chip8::SetExternalTimers), maybe a present, then sleep until the next
+// frame is due. After every ADJUST_FRAMES frames the governor looks at the
+// host time the batches and presents took and picks:
+//
+//   - the present interval: present every Nth frame, the smallest N whose
+//     present cost still leaves room for the target speed, but never more
+//     frames apart than the latency target allows;
+//   - the instructions per frame: as many as fit in the budget that's left,
+//     up to the target. Cuts apply at once, raises go half way per step so
+//     one quiet window doesn't cause a spike.
+//
+// Nothing is known about the costs before the first window, so it runs at
+// START_CYCLES_PER_FRAME (or the target, if lower) and the speed climbs from
+// there; an uncapped target would otherwise spend 15 frames far over budget.
+//
+// The timers keep ticking at 60 Hz whatever is decided, so games keep
+// their pace and only the CPU-bound parts slow down.
+struct GovernorOptions {
+  double cpuBudget = 0.25;               // Fraction of one core.
+  double latencyTargetMs = 100.0;        // Longest gap between presents.
+  unsigned int targetCyclesPerFrame = 16;  // Speed when the budget allows.
+};
+
+class Governor {
+ public:
+  static constexpr unsigned int FRAME_RATE = 60;
+  static constexpr unsigned int ADJUST_FRAMES = 15;
+  static constexpr unsigned int START_CYCLES_PER_FRAME = 16;
+
+  explicit Governor(GovernorOptions const& options);
+
+  // Instructions to run in the next frame.
+  unsigned int CyclesPerFrame() const;
+
+  // Present frames whose number is a multiple of this.
+  unsigned int PresentInterval() const;
+
+  // Host time used over the last adjustment window, as a fraction of one
+  // core (1.0 = a whole core).
+  double Load() const;
+
+  // Report a finished frame: instructions run, host time running them, and
+  // host time presenting (0 if it wasn't presented).
+  void EndFrame(unsigned int cycles, uint64_t emulationNs, uint64_t presentNs,
+                bool presented);
+
+ private:
+  void Adjust();
+
+  GovernorOptions options;
+  unsigned int cyclesPerFrame;
+  unsigned int presentInterval{1};
+  double load{};
+
+  // Current window.
+  unsigned int frames{};
+  uint64_t cycles{};
+  uint64_t emulationNs{};
+  uint64_t presentNs{};
+  unsigned int presents{};
+
+  // Last known costs, kept across windows without samples.
+  double nsPerCycle{};
+  double nsPerPresent{};
+};
@@ -0,0 +1,312 @@
+#include "library.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#include "byteorder.hpp"
+#include "chip8.hpp"
+
+const unsigned int HEADER_SIZE = 4 + 4 + 4;
+const unsigned int LIBRARY_ENTRY_SIZE =
+    8 + 4 + 4 + 4 + 4 + 4 + 2 + 2 + 2 + 1 + 1;
+const unsigned int BLOCK_SIZE = 2 + 2 + 1;
+const uint16_t START_ADDRESS = 0x200;
+
+uint16_t RecommendedIps(Variant variant) {
+  // The COSMAC VIP managed roughly 500 simple instructions a second; the
+  // HP48 and Octo defaults are about twice that.
+  return variant == Variant::CHIP8 ? 500 : 1000;
+}
+
+uint64_t HashRom(uint8_t const* data, size_t size) {
+  uint64_t hash = 0xCBF29CE484222325ull;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * 0x100000001B3ull;
+  }
+  return hash;
+}
+
+// =============================
+// ========== Indexer ==========
+// =============================
+
+namespace {
+
+struct Analysed {
+  uint64_t hash;
+  std::string name;
+  std::vector<uint8_t> rom;
+  std::vector<BasicBlock> blocks;
+  Variant variant;
+  uint16_t reachableBytes;
+  uint8_t flags;
+};
+
+bool SuperChipOnly(uint16_t op) {
+  return ((op & 0xFFF0u) == 0x00C0u && (op & 0xFu) != 0) ||
+         (op >= 0x00FBu && op <= 0x00FFu) || (op & 0xF0FFu) == 0xF030u ||
+         (op & 0xF0FFu) == 0xF075u || (op & 0xF0FFu) == 0xF085u ||
+         (op & 0xF00Fu) == 0xD000u;
+}
+
+bool XoChipOnly(uint16_t op) {
+  return (op & 0xFFF0u) == 0x00D0u || (op & 0xF00Fu) == 0x5002u ||
+         (op & 0xF00Fu) == 0x5003u || op == 0xF000u || op == 0xF002u ||
+         (op & 0xF0FFu) == 0xF001u || (op & 0xF0FFu) == 0xF03Au;
+}
+
+// Everything the index records about one ROM, from its reachable code.
+void Analyse(Analysed& rom) {
+  rom.blocks = BuildCfg(rom.rom.data(), rom.rom.size(), START_ADDRESS,
+                        START_ADDRESS);
+
+  bool superChip = false;
+  bool xoChip = false;
+  uint16_t romEnd = START_ADDRESS + rom.rom.size();
+  // Blocks overlap where code jumps into the middle of another block.
+  std::vector<bool> reachable(rom.rom.size());
+
+  for (BasicBlock const& block : rom.blocks) {
+    bool indexInProgram = false;
+
+    for (uint16_t pc = block.start; pc + 1 < block.end && pc + 1 < romEnd;
+         pc += 2) {
+      uint16_t op = (rom.rom[pc - START_ADDRESS] << 8u) |
+                    rom.rom[pc - START_ADDRESS + 1];
+      reachable[pc - START_ADDRESS] = true;
+      reachable[pc - START_ADDRESS + 1] = true;
+      superChip = superChip || SuperChipOnly(op);
+      xoChip = xoChip || XoChipOnly(op);
+
+      if ((op & 0xF000u) == 0xA000u) {
+        uint16_t target = op & 0x0FFFu;
+        indexInProgram = target >= START_ADDRESS && target < romEnd;
+      } else if ((op & 0xF000u) == 0xB000u) {
+        rom.flags |= LIBRARY_INDIRECT_JUMPS;
+      } else if ((op & 0xF0FFu) == 0xF00Au) {
+        rom.flags |= LIBRARY_WAITS_FOR_KEYS;
+      } else if ((op & 0xF0FFu) == 0xF055u && indexInProgram) {
+        rom.flags |= LIBRARY_SELF_MODIFYING;
+      }
+    }
+  }
+  rom.reachableBytes = std::count(reachable.begin(), reachable.end(), true);
+
+  if (xoChip && rom.variant != Variant::XOCHIP) {
+    rom.variant = Variant::XOCHIP;
+    rom.flags |= LIBRARY_VARIANT_FROM_CODE;
+  } else if (superChip && rom.variant == Variant::CHIP8) {
+    rom.variant = Variant::SCHIP;
+    rom.flags |= LIBRARY_VARIANT_FROM_CODE;
+  }
+}
+
+}  // namespace
+
+long RomLibrary::Build(char const* directory, char const* indexFilename,
+                       std::ostream& log) {
+  namespace fs = std::filesystem;
+
+  std::vector<Analysed> roms;
+  std::error_code error;
+  for (fs::recursive_directory_iterator
+           it(directory, fs::directory_options::skip_permission_denied, error),
+       end;
+       it != end; it.increment(error)) {
+    std::string extension = it->path().extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    if (!it->is_regular_file() ||
+        (extension != ".ch8" && extension != ".sc8" && extension != ".xo8")) {
+      continue;
+    }
+
+    Analysed rom{};
+    rom.name = fs::relative(it->path(), directory).generic_string();
+    std::ifstream file(it->path(), std::ios::binary);
+    rom.rom.assign(std::istreambuf_iterator<char>(file),
+                   std::istreambuf_iterator<char>());
+    if (rom.rom.empty() || rom.rom.size() > MEM_SIZE - START_ADDRESS) {
+      log << "Skipping " << rom.name << ": " << rom.rom.size() << " bytes\n";
+      continue;
+    }
+
+    rom.hash = HashRom(rom.rom.data(), rom.rom.size());
+    rom.variant = VariantFromFilename(rom.name.c_str());
+    Analyse(rom);
+    roms.push_back(std::move(rom));
+  }
+
+  std::sort(roms.begin(), roms.end(),
+            [](Analysed const& a, Analysed const& b) {
+              return a.hash < b.hash || (a.hash == b.hash && a.name < b.name);
+            });
+
+  // Copies of the same ROM under several names are kept once.
+  std::vector<Analysed> unique;
+  for (Analysed& rom : roms) {
+    if (!unique.empty() && unique.back().hash == rom.hash) {
+      log << "Skipping " << rom.name << ": same as " << unique.back().name
+          << "\n";
+    } else {
+      unique.push_back(std::move(rom));
+    }
+  }
+
+  std::string entries;
+  std::string blobs;
+  uint32_t dataStart = HEADER_SIZE + unique.size() * LIBRARY_ENTRY_SIZE;
+
+  for (Analysed const& rom : unique) {
+    uint32_t romOffset = dataStart + blobs.size();
+    blobs.append(rom.rom.begin(), rom.rom.end());
+
+    uint32_t blocksOffset = dataStart + blobs.size();
+    for (BasicBlock const& block : rom.blocks) {
+      PutU16LE(blobs, block.start);
+      PutU16LE(blobs, block.end);
+      blobs += static_cast<char>(block.exit);
+    }
+
+    uint32_t nameOffset = dataStart + blobs.size();
+    blobs += rom.name;
+
+    PutU64LE(entries, rom.hash);
+    PutU32LE(entries, romOffset);
+    PutU32LE(entries, rom.rom.size());
+    PutU32LE(entries, blocksOffset);
+    PutU32LE(entries, rom.blocks.size());
+    PutU32LE(entries, nameOffset);
+    PutU16LE(entries, std::min<size_t>(rom.name.size(), 0xFFFFu));
+    PutU16LE(entries, RecommendedIps(rom.variant));
+    PutU16LE(entries, rom.reachableBytes);
+    entries += static_cast<char>(rom.variant);
+    entries += static_cast<char>(rom.flags);
+  }
+
+  std::string header = "C8LB";
+  PutU32LE(header, LIBRARY_VERSION);
+  PutU32LE(header, unique.size());
+
+  std::ofstream file(indexFilename, std::ios::binary);
+  file << header << entries << blobs;
+  file.close();
+  return file ? static_cast<long>(unique.size()) : -1;
+}
+
+// =============================
+// ========== Reader ==========
+// =============================
+
+RomLibrary::RomLibrary(char const* indexFilename) : file(indexFilename) {
+  data = file.Data();
+  size = file.Size();
+
+  if (size < HEADER_SIZE || std::memcmp(data, "C8LB", 4) != 0 ||
+      GetU32LE(data + 4) != LIBRARY_VERSION) {
+    size = 0;
+    return;
+  }
+
+  count = GetU32LE(data + 8);
+  if (HEADER_SIZE + uint64_t(count) * LIBRARY_ENTRY_SIZE > size) {
+    size = 0;
+    return;
+  }
+
+  // Check every entry once, so lookups can trust the offsets, and callers
+  // the ROM size and speed (both are divided by) and the variant.
+  for (uint32_t i = 0; i < count; i++) {
+    uint8_t const* p = data + HEADER_SIZE + i * LIBRARY_ENTRY_SIZE;
+    uint32_t romSize = GetU32LE(p + 12);
+    if (romSize == 0 || romSize > MEM_SIZE - START_ADDRESS ||
+        GetU32LE(p + 8) + uint64_t(romSize) > size ||
+        GetU32LE(p + 16) + uint64_t(GetU32LE(p + 20)) * BLOCK_SIZE > size ||
+        GetU32LE(p + 24) + uint64_t(GetU16LE(p + 28)) > size ||
+        GetU16LE(p + 30) == 0 ||
+        p[34] > static_cast<uint8_t>(Variant::XOCHIP)) {
+      size = 0;
+      return;
+    }
+  }
+}
+
+bool RomLibrary::Ok() const { return size != 0; }
+
+size_t RomLibrary::Count() const { return Ok() ? count : 0; }
+
+RomInfo RomLibrary::Entry(size_t index) const {
+  uint8_t const* p = data + HEADER_SIZE + index * LIBRARY_ENTRY_SIZE;
+
+  RomInfo info;
+  info.hash = GetU64LE(p);
+  info.rom = data + GetU32LE(p + 8);
+  info.size = GetU32LE(p + 12);
+  info.blocks = data + GetU32LE(p + 16);
+  info.blockCount = GetU32LE(p + 20);
+  info.name = std::string_view(reinterpret_cast<char const*>(data) +
+                                   GetU32LE(p + 24),
+                               GetU16LE(p + 28));
+  info.instructionsPerSecond = GetU16LE(p + 30);
+  info.reachableBytes = GetU16LE(p + 32);
+  info.variant = static_cast<Variant>(p[34]);
+  info.flags = p[35];
+  return info;
+}
+
+LibraryBlock RomLibrary::Block(RomInfo const& rom, uint32_t block) const {
+  uint8_t const* p = rom.blocks + block * BLOCK_SIZE;
+  return {GetU16LE(p), GetU16LE(p + 2), static_cast<Flow>(p[4])};
+}
+
+bool RomLibrary::Find(std::string const& key, RomInfo& info) const {
+  // Hash prefixes: entries are sorted by hash, so matches are adjacent.
+  bool hex = key.size() >= 4 && key.size() <= 16 &&
+             key.find_first_not_of("0123456789abcdefABCDEF") ==
+                 std::string::npos;
+  if (hex && Ok()) {
+    unsigned int shift = 64 - 4 * key.size();
+    uint64_t low = std::stoull(key, nullptr, 16) << shift;
+    uint64_t high = low | (shift ? (~0ull >> (64 - shift)) : 0);
+
+    uint32_t first = 0;
+    uint32_t last = count;
+    while (first < last) {
+      uint32_t middle = (first + last) / 2;
+      if (GetU64LE(data + HEADER_SIZE + middle * LIBRARY_ENTRY_SIZE) < low) {
+        first = middle + 1;
+      } else {
+        last = middle;
+      }
+    }
+
+    uint32_t matches = 0;
+    for (uint32_t i = first; i < count && Entry(i).hash <= high; i++) {
+      matches++;
+    }
+    if (matches == 1) {
+      info = Entry(first);
+      return true;
+    }
+  }
+
+  // Names: the indexed path, the file name, or the file name without its
+  // extension.
+  unsigned int matches = 0;
+  for (size_t i = 0; i < Count(); i++) {
+    RomInfo candidate = Entry(i);
+    std::string_view file = candidate.name.substr(
+        candidate.name.find_last_of('/') + 1);
+    std::string_view stem = file.substr(0, file.find_last_of('.'));
+
+    if (candidate.name == key || file == key || stem == key) {
+      info = candidate;
+      matches++;
+    }
+  }
+  return matches == 1;
+}
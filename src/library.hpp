@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cfg.hpp"
+#include "mappedfile.hpp"
+#include "quirks.hpp"
+
+// ROM library index (.c8l): every ROM under a directory, analysed once, in
+// one file that is memory-mapped at startup. A ROM can then be started by
+// name or hash without opening, hashing or analysing it again.
+//
+// Layout (all integers little-endian):
+//
+//   Header   "C8LB", version u32, entry count u32
+//   Entries  sorted by hash, LIBRARY_ENTRY_SIZE bytes each:
+//              hash u64, ROM offset u32, ROM size u32, blocks offset u32,
+//              block count u32, name offset u32, name length u16,
+//              instructions per second u16, reachable bytes u16,
+//              variant u8, flags u8
+//   Data     ROM images, block tables (start u16, end u16, exit u8 per
+//            block, the BuildCfg() result from 0x200) and names (paths
+//            relative to the scanned directory)
+
+const unsigned int LIBRARY_VERSION = 1;
+
+// What the analysis found, in RomInfo::flags.
+enum LibraryFlags : uint8_t {
+  // The variant comes from instructions only that variant has, not from the
+  // file extension.
+  LIBRARY_VARIANT_FROM_CODE = 1u << 0u,
+  // Reachable Bnnn: some code can only be found at run time.
+  LIBRARY_INDIRECT_JUMPS = 1u << 1u,
+  // Reachable Fx0A: waits for key presses.
+  LIBRARY_WAITS_FOR_KEYS = 1u << 2u,
+  // Reachable Fx55 after an Annn that points into the program: likely
+  // rewrites its own code.
+  LIBRARY_SELF_MODIFYING = 1u << 3u,
+};
+
+struct LibraryBlock {
+  uint16_t start;
+  uint16_t end;
+  Flow exit;
+};
+
+// One indexed ROM. Pointers point into the mapped index and stay valid as
+// long as the RomLibrary does.
+struct RomInfo {
+  uint64_t hash;
+  std::string_view name;
+  uint8_t const* rom;
+  uint32_t size;
+  Variant variant;
+  uint16_t instructionsPerSecond;
+  uint16_t reachableBytes;  // Covered by the statically known blocks.
+  uint8_t flags;
+  uint32_t blockCount;
+  uint8_t const* blocks;
+};
+
+// A sensible starting speed for ROMs written for "variant".
+uint16_t RecommendedIps(Variant variant);
+
+// FNV-1a (64-bit) of a ROM image, as stored in the index.
+uint64_t HashRom(uint8_t const* data, size_t size);
+
+class RomLibrary {
+ public:
+  // Scan "directory" (recursively) for .ch8, .sc8 and .xo8 files and write
+  // the index to "indexFilename". Progress and skipped files go to "log".
+  // Returns the number of ROMs indexed, or -1 if the index can't be written.
+  static long Build(char const* directory, char const* indexFilename,
+                    std::ostream& log);
+
+  // Maps an index written by Build() (reads it on platforms without mmap).
+  explicit RomLibrary(char const* indexFilename);
+
+  RomLibrary(RomLibrary const&) = delete;
+  RomLibrary& operator=(RomLibrary const&) = delete;
+
+  bool Ok() const;
+  size_t Count() const;
+  RomInfo Entry(size_t index) const;
+  LibraryBlock Block(RomInfo const& rom, uint32_t block) const;
+
+  // Look a ROM up by hash (a hex prefix of at least 4 digits), by path as
+  // indexed, or by file name with or without extension. Returns false if
+  // nothing, or more than one ROM, matches.
+  bool Find(std::string const& key, RomInfo& info) const;
+
+ private:
+  MappedFile file;
+  uint8_t const* data{};
+  size_t size{};  // 0 if the file isn't a valid index.
+  uint32_t count{};
+};
@@ -1,46 +1,809 @@
+#include <algorithm>
 #include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
 
+#include "audio.hpp"
+#include "capture.hpp"
 #include "chip8.hpp"
+#include "debugger.hpp"
+#include "governor.hpp"
+#include "library.hpp"
+#include "phosphor.hpp"
 #include "platform.hpp"
+#include "recompiled.hpp"
+#include "replay.hpp"
+#include "stream.hpp"
+#include "telemetry.hpp"
+#include "terminal.hpp"
+#include "wall.hpp"
+
+// Set by SIGUSR1: write the telemetry file at the next chance.
+static volatile std::sig_atomic_t telemetryDumpRequested = 0;
+
+static void RequestTelemetryDump(int) { telemetryDumpRequested = 1; }
+
+// "RRGGBB:RRGGBB" (unlit, lit) to two RGBA8888 colours.
+static bool ParseColors(char const* text, uint32_t& off, uint32_t& on) {
+  unsigned int offRgb, onRgb;
+  char end;
+  if (std::strlen(text) != 13 ||
+      std::sscanf(text, "%6x:%6x%c", &offRgb, &onRgb, &end) != 2) {
+    return false;
+  }
+  off = (offRgb << 8u) | 0xFFu;
+  on = (onRgb << 8u) | 0xFFu;
+  return true;
+}
 
 int main(int argc, char** argv) {
-  if (argc != 4) {
-    std::cerr << "Usage: " << argv[0] << " <Scale> <Delay> <ROM>\n";
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0] << " <Scale> <Delay> <ROM> [Options]\n"
+              << "<ROM> may also be a .c8r replay (Left/Right skip 5 s)\n"
+              << "<Delay> may be auto: the ROM's recommended speed\n"
+              << "Options:\n"
+              << "  --phosphor        Blend frames to hide sprite flicker\n"
+              << "  --colors <Off>:<On> Window colours as RRGGBB:RRGGBB\n"
+              << "  --capture <File>  Record frames to .y4m, .png or .gif\n"
+              << "  --headless        Run without a window\n"
+              << "  --terminal        Draw in the terminal instead of a window\n"
+              << "  --cycles <N>      Stop after N cycles (0 = never)\n"
+              << "  --wav <File>      Write the beeper to a WAV file\n"
+              << "  --mute            Don't open a sound device\n"
+              << "  --turbo           Always fast-forward (else hold Tab)\n"
+              << "  --turbo-speed <N> Fast-forward speed, 0 = uncapped\n"
+              << "  --frameskip <K>   Present every Kth frame when fast\n"
+              << "  --variant <Name>  chip8, schip or xochip quirks\n"
+              << "  --debug           Start stopped, take debugger commands\n"
+              << "                    on stdin (type help)\n"
+              << "  --telemetry <File> Write timing histograms as JSON at\n"
+              << "                    exit (and on SIGUSR1)\n"
+              << "  --overlay         Draw timing bars over the picture\n"
+              << "  --record <File>   Record a .c8r replay of the session\n"
+              << "  --keyframe-interval <N> Cycles between replay keyframes\n"
+              << "  --seek <Cycle>    Start a replay at that cycle\n"
+              << "  --stream <Socket> Serve frames to viewers on a Unix socket\n"
+              << "  --library <Index> Find <ROM> by name or hash in a chip8lib\n"
+              << "                    index\n"
+              << "  --cpu-budget <Fraction> Run in 60 Hz frames using at most\n"
+              << "                    this share of a core, slowing down if\n"
+              << "                    needed\n"
+              << "  --latency-target <ms> Longest gap between presented frames\n"
+              << "                    under --cpu-budget (default 100)\n"
+              << "  --wall <N>        Run N copies of <ROM> tiled in one window\n"
+              << "  --faults <Policy> ignore, trap (report at exit) or halt\n"
+              << "                    (stop at the first bad instruction)\n";
     std::exit(EXIT_FAILURE);
   }
 
   int videoScale = std::stoi(argv[1]);
-  int cycleDelay = std::stoi(argv[2]);
+  bool autoDelay = std::strcmp(argv[2], "auto") == 0;
+  int cycleDelay = autoDelay ? 0 : std::stoi(argv[2]);
   char const* romFilename = argv[3];
 
-  Platform platform("CHIP-8 Emulator", PX_WIDTH * videoScale,
-                    PX_HEIGHT * videoScale, PX_WIDTH, PX_HEIGHT);
+  bool usePhosphor = false;
+  bool customColors = false;
+  uint32_t offColor = 0, onColor = 0;
+  bool headless = false;
+  bool useTerminal = false;
+  unsigned long maxCycles = 0;
+  char const* captureFilename = nullptr;
+  char const* wavFilename = nullptr;
+  bool mute = false;
+  bool turbo = false;
+  unsigned int turboSpeed = 0;
+  unsigned int frameSkip = 10;
+  // Picked from the ROM's extension unless --variant says otherwise.
+  Variant variant = VariantFromFilename(romFilename);
+  bool variantGiven = false;
+  bool debug = false;
+  char const* telemetryFilename = nullptr;
+  bool showOverlay = false;
+  char const* recordFilename = nullptr;
+  unsigned int keyframeInterval = 10000;
+  unsigned long seekFrame = 0;
+  char const* streamPath = nullptr;
+  char const* libraryFilename = nullptr;
+  double cpuBudget = 0.0;
+  double latencyTargetMs = 100.0;
+  unsigned int wallCount = 0;
+  FaultPolicy faultPolicy = FaultPolicy::IGNORE;
+
+  for (int i = 4; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+
+    if (std::strcmp(argv[i], "--phosphor") == 0) {
+      usePhosphor = true;
+    } else if (std::strcmp(argv[i], "--colors") == 0 && hasValue) {
+      if (!ParseColors(argv[++i], offColor, onColor)) {
+        std::cerr << "--colors wants RRGGBB:RRGGBB, got " << argv[i] << "\n";
+        std::exit(EXIT_FAILURE);
+      }
+      customColors = true;
+    } else if (std::strcmp(argv[i], "--headless") == 0) {
+      headless = true;
+    } else if (std::strcmp(argv[i], "--terminal") == 0) {
+      useTerminal = true;
+    } else if (std::strcmp(argv[i], "--cycles") == 0 && hasValue) {
+      maxCycles = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--capture") == 0 && hasValue) {
+      captureFilename = argv[++i];
+    } else if (std::strcmp(argv[i], "--wav") == 0 && hasValue) {
+      wavFilename = argv[++i];
+    } else if (std::strcmp(argv[i], "--mute") == 0) {
+      mute = true;
+    } else if (std::strcmp(argv[i], "--turbo") == 0) {
+      turbo = true;
+    } else if (std::strcmp(argv[i], "--turbo-speed") == 0 && hasValue) {
+      turboSpeed = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--frameskip") == 0 && hasValue) {
+      frameSkip = std::max(1ul, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--variant") == 0 && hasValue) {
+      if (!ParseVariant(argv[++i], variant)) {
+        std::cerr << "Unknown variant: " << argv[i] << "\n";
+        std::exit(EXIT_FAILURE);
+      }
+      variantGiven = true;
+    } else if (std::strcmp(argv[i], "--debug") == 0) {
+      debug = true;
+    } else if (std::strcmp(argv[i], "--telemetry") == 0 && hasValue) {
+      telemetryFilename = argv[++i];
+    } else if (std::strcmp(argv[i], "--overlay") == 0) {
+      showOverlay = true;
+    } else if (std::strcmp(argv[i], "--record") == 0 && hasValue) {
+      recordFilename = argv[++i];
+    } else if (std::strcmp(argv[i], "--keyframe-interval") == 0 &&
+               hasValue) {
+      keyframeInterval = std::max(1ul, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--seek") == 0 && hasValue) {
+      seekFrame = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--stream") == 0 && hasValue) {
+      streamPath = argv[++i];
+    } else if (std::strcmp(argv[i], "--library") == 0 && hasValue) {
+      libraryFilename = argv[++i];
+    } else if (std::strcmp(argv[i], "--cpu-budget") == 0 && hasValue) {
+      cpuBudget = std::stod(argv[++i]);
+      if (cpuBudget <= 0.0) {
+        std::cerr << "--cpu-budget must be above 0\n";
+        std::exit(EXIT_FAILURE);
+      }
+    } else if (std::strcmp(argv[i], "--latency-target") == 0 && hasValue) {
+      latencyTargetMs = std::max(1.0, std::stod(argv[++i]));
+    } else if (std::strcmp(argv[i], "--wall") == 0 && hasValue) {
+      wallCount = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--faults") == 0 && hasValue) {
+      if (!ParseFaultPolicy(argv[++i], faultPolicy)) {
+        std::cerr << "Unknown fault policy: " << argv[i] << "\n";
+        std::exit(EXIT_FAILURE);
+      }
+    } else {
+      std::cerr << "Unknown option: " << argv[i] << "\n";
+      std::exit(EXIT_FAILURE);
+    }
+  }
+
+  // The index is mapped for the whole run; "rom" points into it.
+  std::unique_ptr<RomLibrary> library;
+  RomInfo rom{};
+  if (libraryFilename) {
+    library = std::make_unique<RomLibrary>(libraryFilename);
+    if (!library->Ok()) {
+      std::cerr << "Not a valid ROM library: " << libraryFilename << "\n";
+      std::exit(EXIT_FAILURE);
+    }
+    if (!library->Find(romFilename, rom)) {
+      std::cerr << "No single ROM in the library matches " << romFilename
+                << "\n";
+      std::exit(EXIT_FAILURE);
+    }
+    if (!variantGiven) {
+      variant = rom.variant;
+    }
+  }
+
+  if (autoDelay) {
+    uint16_t ips =
+        library ? rom.instructionsPerSecond : RecommendedIps(variant);
+    cycleDelay = std::max(1, 1000 / ips);
+  }
+
+  size_t romNameLength = std::strlen(romFilename);
+  bool isReplay = !library && romNameLength >= 4 &&
+                  std::strcmp(romFilename + romNameLength - 4, ".c8r") == 0;
+
+  // The debugger runs cycles on its own, which neither side of a replay
+  // would see.
+  if (debug && (isReplay || recordFilename)) {
+    std::cerr << "--debug can't be combined with replays\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  // Replays hold one input frame per cycle and tick the timers in every
+  // cycle; the debugger runs cycles on its own. Neither fits governed frames.
+  if (cpuBudget > 0.0 && (isReplay || recordFilename || debug)) {
+    std::cerr << "--cpu-budget can't be combined with replays or --debug\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  // Both want stdin.
+  if (debug && useTerminal) {
+    std::cerr << "--debug can't be combined with --terminal\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (headless && maxCycles == 0 && !streamPath) {
+    std::cerr << "--headless needs --cycles (or --stream), there is no window"
+                 " to close\n";
+    std::exit(EXIT_FAILURE);
+  }
+
+  if (wallCount > 0) {
+    // The wall has its own loop: one scheduler frame and one present per
+    // refresh for all machines, see wall.hpp.
+    if (isReplay || recordFilename || debug || headless || useTerminal ||
+        streamPath || captureFilename || wavFilename || usePhosphor ||
+        cpuBudget > 0.0 || telemetryFilename || showOverlay) {
+      std::cerr << "--wall only combines with --cycles, --variant, --colors,"
+                   " --faults and --library\n";
+      std::exit(EXIT_FAILURE);
+    }
+
+    std::vector<std::unique_ptr<Chip8>> machines;
+    for (unsigned int i = 0; i < wallCount; i++) {
+      auto chip8 = std::make_unique<Chip8>();
+      if (library) {
+        chip8->LoadROM(rom.rom, rom.size);
+      } else {
+        chip8->LoadROM(romFilename);
+      }
+      chip8->SetVariant(variant);
+      chip8->SetFaultPolicy(faultPolicy);
+      // Different random numbers, so the copies don't all play alike.
+      chip8->Seed(i + 1);
+      machines.push_back(std::move(chip8));
+    }
+
+    unsigned int columns, rows;
+    WallGrid(wallCount, columns, rows);
+    Platform wall("CHIP-8 Wall", columns * PX_WIDTH * videoScale,
+                  rows * PX_HEIGHT * videoScale, columns * HIRES_WIDTH,
+                  rows * HIRES_HEIGHT);
+    if (customColors) {
+      wall.SetPalette(offColor, onColor);
+    }
+
+    unsigned int cyclesPerFrame =
+        std::max(1, 1000 / (std::max(cycleDelay, 1) * 60));
+    RunWall(wall, machines, cyclesPerFrame,
+            (maxCycles + cyclesPerFrame - 1) / cyclesPerFrame);
+    return 0;
+  }
+
+  std::unique_ptr<Capture> capture;
+  if (captureFilename) {
+    CaptureFormat format;
+    if (!Capture::FormatFromPath(captureFilename, format)) {
+      std::cerr << "Unknown capture format: " << captureFilename << "\n";
+      std::exit(EXIT_FAILURE);
+    }
+    capture = std::make_unique<Capture>(format, captureFilename);
+  }
+
+  // Declared before the platform so it outlives the sound device, whose
+  // callback renders from it until ~Platform closes the device.
+  Beeper beeper;
+
+  // From here on, errors return from main instead of calling std::exit:
+  // the terminal is in raw mode with the cursor hidden until ~Terminal.
+  std::unique_ptr<Platform> platform;
+  std::unique_ptr<Terminal> terminal;
+  if (useTerminal && !headless) {
+    terminal = std::make_unique<Terminal>();
+  } else if (!headless) {
+    platform = std::make_unique<Platform>(
+        "CHIP-8 Emulator", PX_WIDTH * videoScale, PX_HEIGHT * videoScale,
+        HIRES_WIDTH, HIRES_HEIGHT);
+  }
+
+  std::unique_ptr<StreamServer> stream;
+  if (streamPath) {
+    stream = std::make_unique<StreamServer>(streamPath);
+    if (!stream->Ok()) {
+      std::cerr << "Can't listen on " << streamPath << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Off unless asked for; then a few clock reads per presented frame.
+  std::unique_ptr<Telemetry> telemetry;
+  if (telemetryFilename || showOverlay) {
+    telemetry = std::make_unique<Telemetry>();
+    if (platform) {
+      platform->SetTelemetry(telemetry.get());
+    }
+  }
+#ifdef SIGUSR1
+  if (telemetryFilename) {
+    std::signal(SIGUSR1, RequestTelemetryDump);
+  }
+#endif
+
+  // The beeper has exactly one consumer: the WAV file if asked for,
+  // otherwise the sound device.
+  std::unique_ptr<WavSink> wav;
+  if (wavFilename) {
+    wav = std::make_unique<WavSink>(wavFilename);
+  } else if (platform && !mute) {
+    if (!platform->StartAudio(&beeper)) {
+      std::cerr << "No audio device, continuing without sound\n";
+    }
+  }
+
+  // Schedule beeper changes one device buffer ahead of the audio clock, so
+  // they land at the right sample instead of at the next buffer boundary.
+  const uint64_t AUDIO_LATENCY_SAMPLES = 512;
+  bool wasBeeping = false;
 
   Chip8 chip8;
-  chip8.LoadROM(romFilename);
 
-  int videoPitch = sizeof(chip8.video[0]) * PX_WIDTH;
+  // Replays: one frame per cycle, as recorded by this front end.
+  std::unique_ptr<ReplayReader> replay;
+  std::unique_ptr<ReplayWriter> recorder;
+  uint64_t replayFrame = seekFrame;
+
+  if (isReplay) {
+    replay = std::make_unique<ReplayReader>(romFilename);
+    if (!replay->Ok()) {
+      std::cerr << "Not a valid replay: " << romFilename << "\n";
+      return EXIT_FAILURE;
+    }
+    replay->Setup(chip8);
+    if (!replay->Seek(chip8, replayFrame)) {
+      std::cerr << "The replay is only " << replay->FrameCount()
+                << " cycles long\n";
+      return EXIT_FAILURE;
+    }
+  } else {
+    if (library) {
+      chip8.LoadROM(rom.rom, rom.size);
+    } else {
+      chip8.LoadROM(romFilename);
+    }
+    chip8.SetVariant(variant);
+
+#ifdef CHIP8_HAS_RECOMPILED
+    // This build carries an ahead-of-time translation of one ROM.
+    if (!chip8.AttachRecompiled(&RECOMPILED_ROM)) {
+      std::cerr << "Recompiled code is for a different ROM, interpreting\n";
+    }
+#endif
+  }
+
+  chip8.SetFaultPolicy(faultPolicy);
+
+  if (recordFilename) {
+    recorder = std::make_unique<ReplayWriter>(recordFilename, variant, 1,
+                                              keyframeInterval);
+    if (!recorder->Ok()) {
+      std::cerr << "Can't write " << recordFilename << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Keys typed into the window don't reach the machine during a replay.
+  uint8_t ignoredKeys[KEY_COUNT]{};
+
+  // Only consulted while it has something to do, see Debugger::Active().
+  std::unique_ptr<Debugger> debugger;
+  std::unique_ptr<DebugConsole> console;
+  if (debug) {
+    debugger = std::make_unique<Debugger>(std::cout);
+    console = std::make_unique<DebugConsole>();
+    debugger->Stop(chip8, "Stopped at entry, type help for commands");
+  }
+
+  // Governed runs: a batch of cycles and one timer tick per 60 Hz frame,
+  // sized to fit the CPU budget, see Governor.
+  std::unique_ptr<Governor> governor;
+  if (cpuBudget > 0.0) {
+    GovernorOptions options;
+    options.cpuBudget = cpuBudget;
+    options.latencyTargetMs = latencyTargetMs;
+    // <Delay> 0 means uncapped; the budget is then the only limit.
+    options.targetCyclesPerFrame =
+        cycleDelay > 0 ? std::max(1, 1000 / (cycleDelay * 60)) : 1000000;
+    governor = std::make_unique<Governor>(options);
+    chip8.SetExternalTimers(true);
+  }
+
+  int videoPitch = sizeof(uint32_t) * PX_WIDTH;
 
-  auto lastCycleTime = std::chrono::high_resolution_clock::now();
+  // Only touched when a frame is presented, see Phosphor::Apply.
+  Phosphor phosphor;
+  uint32_t phosphorVideo[PX_WIDTH * PX_HEIGHT]{};
+
+  // A theme is only a palette: the machine still draws 0 and 0xFFFFFFFF.
+  // Only the window shows it; the terminal thresholds phosphor frames on
+  // grey levels, which a tint would scramble.
+  if (customColors && platform) {
+    phosphor.SetColors(offColor, onColor);
+    platform->SetPalette(offColor, onColor);
+  }
+
+  // Fast-forward: while active, run "turboSpeed" times faster than <Delay>
+  // allows (0 = as fast as possible) and only present every Kth frame.
+  // Timers still tick once per Cycle(), so they follow emulated time.
+  const unsigned long TURBO_BATCH = 1000;
+
+  auto startTime = std::chrono::high_resolution_clock::now();
+  auto lastCycleTime = startTime;
+  unsigned long cycles = 0;
+  unsigned long steps = 0;
   bool quit = false;
 
+  // For the live speed readout.
+  auto lastReportTime = startTime;
+  unsigned long lastReportCycles = 0;
+
+  // Telemetry: emulation time is accumulated across passes through the loop
+  // until a frame is presented, leaving out the time spent waiting for the
+  // next cycle to be due.
+  using Clock = std::chrono::high_resolution_clock;
+  auto emulationMark = startTime;
+  Clock::duration emulationTime{};
+  auto lastPresentTime = startTime;
+  Clock::duration lastPresentInterval{};
+  bool presentedBefore = false;
+
+  auto nanoseconds = [](Clock::duration d) -> uint64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  };
+
+  // Governed runs: when the next frame is due, and how many have run.
+  auto nextFrameTime = startTime;
+  unsigned long governedFrame = 0;
+
   while (!quit) {
-    quit = platform.ProcessInput(chip8.keypad);
+    bool fastForward = turbo;
+    int seekSteps = 0;
+    if (platform) {
+      quit = platform->ProcessInput(replay ? ignoredKeys : chip8.keypad);
+      fastForward = fastForward || platform->FastForwardHeld();
+      seekSteps = platform->TakeSeekSteps();
+    } else if (terminal) {
+      quit = terminal->ProcessInput(replay ? ignoredKeys : chip8.keypad);
+      fastForward = fastForward || terminal->FastForwardHeld();
+      seekSteps = terminal->TakeSeekSteps();
+    }
+
+    // Governed runs already go as fast as the budget allows.
+    fastForward = fastForward && !governor;
+
+    if (stream) {
+      stream->ApplyKeys(replay ? ignoredKeys : chip8.keypad);
+    }
+
+    if (seekSteps && replay) {
+      // Five seconds of emulated time per press.
+      int64_t step = 5000 / std::max(cycleDelay, 1);
+      int64_t target = static_cast<int64_t>(replayFrame) + seekSteps * step;
+      replayFrame = std::clamp<int64_t>(
+          target, 0, static_cast<int64_t>(replay->FrameCount()) - 1);
+      replay->Seek(chip8, replayFrame);
+    }
+
+    if (debugger) {
+      std::string line;
+      while (debugger->Stopped() && console->Poll(line)) {
+        debugger->Command(chip8, line);
+      }
+      quit = quit || debugger->QuitRequested();
+    }
 
     auto currentTime = std::chrono::high_resolution_clock::now();
     float dt = std::chrono::duration<float, std::chrono::milliseconds::period>(
                    currentTime - lastCycleTime)
                    .count();
 
-    if (dt > cycleDelay) {
+    // How many cycles are due on this pass through the loop.
+    unsigned long due = 0;
+
+    if (governor) {
+      if (currentTime >= nextFrameTime) {
+        due = governor->CyclesPerFrame();
+        nextFrameTime += std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / Governor::FRAME_RATE));
+        if (nextFrameTime < currentTime) {
+          // Fell more than a frame behind; don't try to catch up.
+          nextFrameTime = currentTime;
+        }
+        governedFrame++;
+      }
+    } else if (headless && !fastForward) {
+      // Headless runs don't wait; <Delay> only sets how much emulated time
+      // each cycle stands for.
+      due = 1;
+    } else if (fastForward) {
+      if (turboSpeed == 0 || cycleDelay == 0) {
+        due = TURBO_BATCH;
+        lastCycleTime = currentTime;
+      } else {
+        float cycleMs = static_cast<float>(cycleDelay) / turboSpeed;
+        due = static_cast<unsigned long>(dt / cycleMs);
+
+        if (due >= TURBO_BATCH) {
+          // The host can't keep up; drop the backlog instead of spiralling.
+          due = TURBO_BATCH;
+          lastCycleTime = currentTime;
+        } else {
+          // Carry the leftover fraction of a cycle into the next pass.
+          lastCycleTime += std::chrono::duration_cast<
+              std::chrono::high_resolution_clock::duration>(
+              std::chrono::duration<float, std::milli>(due * cycleMs));
+        }
+      }
+    } else if (dt > cycleDelay) {
+      due = 1;
       lastCycleTime = currentTime;
+    }
+
+    if (telemetry && due > 0) {
+      emulationMark = Clock::now();
+    }
+
+    auto frameStart = Clock::now();
+    unsigned long frameCycles = cycles;
+    Clock::duration framePresentTime{};
+    bool framePresented = false;
+
+    for (unsigned long i = 0; i < due && !quit;) {
+      // Unpaced runs may execute a whole recompiled block per step. Paced
+      // runs, and replays (one input frame per cycle), stay on single cycles
+      // so <Delay> keeps its meaning.
+      unsigned int executed = 1;
+      if (replay) {
+        if (replayFrame >= replay->FrameCount()) {
+          // Stay on the last frame; headless runs have nothing left to do.
+          quit = headless;
+          break;
+        }
+        replay->ApplyKeys(chip8, replayFrame++);
+        chip8.Cycle();
+      } else if (recorder) {
+        recorder->BeginFrame(chip8);
+        chip8.Cycle();
+      } else if (debugger && debugger->Active()) {
+        // Instruction by instruction, checking breakpoints in between.
+        executed = debugger->Cycle(chip8);
+        if (executed == 0) {
+          break;
+        }
+      } else if (headless || fastForward || governor) {
+        executed = chip8.Step();
+      } else {
+        chip8.Cycle();
+      }
+
+      if (chip8.Halted()) [[unlikely]] {
+        // Nothing will run again. Windows keep showing the last frame.
+        quit = quit || headless;
+        break;
+      }
+      i += executed;
+      cycles += executed;
+      steps++;
 
-      chip8.Cycle();
+      // Headless runs follow emulated time (cycles, or frames when
+      // governed), windowed runs follow the host clock that the viewer (and
+      // the sound device) actually experience.
+      double timeMs =
+          headless ? governor ? governedFrame * 1000.0 / Governor::FRAME_RATE
+                              : static_cast<double>(cycles) * cycleDelay
+                   : std::chrono::duration<double, std::milli>(currentTime -
+                                                               startTime)
+                         .count();
 
-      platform.Update(chip8.video, videoPitch);
+      uint64_t sampleTime =
+          static_cast<uint64_t>(timeMs * AUDIO_SAMPLE_RATE / 1000.0);
+      if (!wav) {
+        sampleTime += AUDIO_LATENCY_SAMPLES;
+      }
+
+      if (chip8.SoundOn() != wasBeeping) {
+        wasBeeping = chip8.SoundOn();
+        beeper.Post(wasBeeping, sampleTime);
+      }
+
+      if (wav) {
+        wav->Pull(beeper, sampleTime);
+      }
+
+      if (maxCycles != 0 && cycles >= maxCycles) {
+        quit = true;
+      }
+
+      // Frame skipping: present only every Kth frame while fast-forwarding,
+      // but always the last one of the run.
+      if (fastForward && steps % frameSkip != 0 && !quit) {
+        continue;
+      }
+
+      // Governed runs present once at the end of a frame, and only every
+      // Nth frame when presenting is what doesn't fit the budget.
+      if (governor && !quit &&
+          (i < due || governedFrame % governor->PresentInterval() != 0)) {
+        continue;
+      }
+      auto presentStart = Clock::now();
+
+      uint32_t const* frame = chip8.Video();
+      if (usePhosphor) {
+        phosphor.Apply(frame, phosphorVideo);
+        frame = phosphorVideo;
+      }
+
+      if (telemetry) {
+        auto now = Clock::now();
+        emulationTime += now - emulationMark;
+        telemetry->Record(Metric::EMULATION, nanoseconds(emulationTime));
+        emulationTime = {};
+
+        if (presentedBefore) {
+          auto interval = now - lastPresentTime;
+          telemetry->Record(Metric::PRESENT_INTERVAL, nanoseconds(interval));
+          telemetry->Record(Metric::JITTER,
+                            nanoseconds(interval > lastPresentInterval
+                                            ? interval - lastPresentInterval
+                                            : lastPresentInterval - interval));
+          lastPresentInterval = interval;
+        }
+        lastPresentTime = now;
+        presentedBefore = true;
+      }
+
+      if (platform || terminal) {
+        if (platform && usePhosphor) {
+          platform->Update(frame, PX_WIDTH, PX_HEIGHT, videoPitch);
+        } else if (platform) {
+          // Only the rows that changed reach the texture.
+          platform->UpdateMono(chip8);
+        } else {
+          terminal->Update(frame);
+        }
+        if (telemetry) {
+          telemetry->Record(Metric::UPDATE,
+                            nanoseconds(Clock::now() - lastPresentTime));
+        }
+      }
+
+      // The encoders threshold on nonzero pixels, which every phosphor
+      // pixel is (its alpha byte), so they get the machine's own frame.
+      if (capture) {
+        capture->Submit(chip8.Video(), timeMs);
+      }
+
+      // Viewers decode a monochrome frame, see stream.hpp.
+      if (stream) {
+        stream->Publish(chip8.Video());
+      }
+
+      if (telemetry) {
+        emulationMark = Clock::now();
+      }
+      framePresentTime += Clock::now() - presentStart;
+      framePresented = true;
     }
+
+    if (telemetry && due > 0) {
+      emulationTime += Clock::now() - emulationMark;
+    }
+
+    if (governor && due > 0) {
+      chip8.TickTimers();
+
+      Clock::duration frameTime = Clock::now() - frameStart;
+      governor->EndFrame(static_cast<unsigned int>(cycles - frameCycles),
+                         nanoseconds(frameTime - framePresentTime),
+                         nanoseconds(framePresentTime), framePresented);
+
+      if (telemetry) {
+        telemetry->Record(Metric::HOST_FRAME, nanoseconds(frameTime));
+        telemetry->SetGauge(Gauge::CYCLES_PER_FRAME,
+                            governor->CyclesPerFrame());
+        telemetry->SetGauge(Gauge::PRESENT_INTERVAL,
+                            governor->PresentInterval());
+        telemetry->SetGauge(Gauge::CPU_LOAD, governor->Load());
+      }
+    }
+
+    if (telemetryDumpRequested) {
+      telemetryDumpRequested = 0;
+      telemetry->WriteJson(telemetryFilename);
+    }
+
+    // Report the achieved speed (emulated time / host time) twice a second.
+    double reportMs = std::chrono::duration<double, std::milli>(
+                          currentTime - lastReportTime)
+                          .count();
+    if (reportMs >= 500.0) {
+      double cyclesPerSecond = (cycles - lastReportCycles) * 1000.0 / reportMs;
+      lastReportTime = currentTime;
+      lastReportCycles = cycles;
+
+      char status[160];
+      if (cycleDelay > 0) {
+        std::snprintf(status, sizeof(status),
+                      "CHIP-8 Emulator - %.1fx (%.0f cycles/s)%s",
+                      cyclesPerSecond * cycleDelay / 1000.0, cyclesPerSecond,
+                      fastForward ? " >>" : "");
+      } else {
+        std::snprintf(status, sizeof(status),
+                      "CHIP-8 Emulator - %.0f cycles/s%s", cyclesPerSecond,
+                      fastForward ? " >>" : "");
+      }
+      if (chip8.Halted()) {
+        size_t length = std::strlen(status);
+        std::snprintf(status + length, sizeof(status) - length,
+                      " [halted: %s]", FaultName(chip8.FirstFault().fault));
+      } else if (governor) {
+        size_t length = std::strlen(status);
+        std::snprintf(status + length, sizeof(status) - length,
+                      " [%u/frame, 1/%u presented, %.0f%% CPU]",
+                      governor->CyclesPerFrame(), governor->PresentInterval(),
+                      governor->Load() * 100.0);
+      }
+
+      if (platform) {
+        platform->SetTitle(status);
+      } else if (terminal) {
+        terminal->SetStatus(status);
+      } else if (fastForward) {
+        std::cerr << status << "\n";
+      }
+
+      if (platform && showOverlay) {
+        // Scaled so that one 60 Hz frame reaches the middle of the window.
+        const double FULL_SCALE_NS = 2 * 1e9 / 60;
+        std::vector<Platform::OverlayBar> bars;
+        for (Metric metric : {Metric::EMULATION, Metric::UPDATE,
+                              Metric::PRESENT_INTERVAL, Metric::JITTER,
+                              Metric::INPUT_LATENCY}) {
+          Histogram const& h = telemetry->Recent(metric);
+          bars.push_back(
+              {static_cast<float>(
+                   std::min(1.0, h.Percentile(0.50) / FULL_SCALE_NS)),
+               static_cast<float>(
+                   std::min(1.0, h.Percentile(0.99) / FULL_SCALE_NS))});
+        }
+        platform->SetOverlay(bars);
+        telemetry->ResetRecent();
+      }
+    }
+
+    if (governor) {
+      std::this_thread::sleep_until(nextFrameTime);
+    }
+  }
+
+  if (telemetryFilename && !telemetry->WriteJson(telemetryFilename)) {
+    std::cerr << "Can't write " << telemetryFilename << "\n";
+  }
+
+  if (chip8.FaultCount() > 0) {
+    FaultInfo fault = chip8.FirstFault();
+    std::fprintf(stderr,
+                 "Fault: %s at 0x%03X (opcode %04X) after %llu cycles, %u in"
+                 " total%s\n",
+                 FaultName(fault.fault), fault.pc, fault.opcode,
+                 static_cast<unsigned long long>(fault.cycle),
+                 chip8.FaultCount(), chip8.Halted() ? ", halted" : "");
   }
 
-  return 0;
+  // Batch runs can tell a halted program from one that ran its course.
+  return chip8.Halted() ? EXIT_FAILURE : 0;
 }
@@ -0,0 +1,50 @@
+#include "mappedfile.hpp"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_MMAP 1
+#endif
+
+MappedFile::MappedFile(char const* filename) {
+#ifdef MAPPED_FILE_MMAP
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    void* memory =
+        mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (memory != MAP_FAILED) {
+      data = static_cast<uint8_t const*>(memory);
+      size = info.st_size;
+      mappedSize = size;
+    }
+  }
+  close(fd);
+#else
+  std::ifstream file(filename, std::ios::binary);
+  fallback.assign(std::istreambuf_iterator<char>(file),
+                  std::istreambuf_iterator<char>());
+  data = fallback.data();
+  size = fallback.size();
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef MAPPED_FILE_MMAP
+  if (mappedSize) {
+    munmap(const_cast<uint8_t*>(data), mappedSize);
+  }
+#endif
+}
+
+uint8_t const* MappedFile::Data() const { return data; }
+
+size_t MappedFile::Size() const { return size; }
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A whole file, read-only, for the formats that are read in place (replays,
+// the ROM library). Memory-mapped where mmap exists, so opening costs
+// nothing up front and pages load on first touch; read into memory
+// elsewhere.
+class MappedFile {
+ public:
+  // Empty (Size() 0) if the file can't be opened or is empty.
+  explicit MappedFile(char const* filename);
+  ~MappedFile();
+
+  MappedFile(MappedFile const&) = delete;
+  MappedFile& operator=(MappedFile const&) = delete;
+
+  uint8_t const* Data() const;
+  size_t Size() const;
+
+ private:
+  uint8_t const* data{};
+  size_t size{};
+  size_t mappedSize{};
+  std::vector<uint8_t> fallback;
+};
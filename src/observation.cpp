@@ -0,0 +1,169 @@
+#include "observation.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OBSERVATION_SSE2 1
+#endif
+
+const unsigned int PX_COUNT = PX_WIDTH * PX_HEIGHT;
+
+// ========== Conversions ==========
+
+#ifdef OBSERVATION_SSE2
+
+static void Pack(uint32_t const* video, uint8_t* packed) {
+  const __m128i zero = _mm_setzero_si128();
+
+  // Same narrowing as Phosphor::Apply: 16 pixels become 16 mask bytes, and
+  // movemask gathers their top bits, pixel j into bit j.
+  for (unsigned int i = 0; i < PX_COUNT; i += 16) {
+    auto const* src = reinterpret_cast<__m128i const*>(video + i);
+    __m128i unlit0 = _mm_cmpeq_epi32(_mm_loadu_si128(src + 0), zero);
+    __m128i unlit1 = _mm_cmpeq_epi32(_mm_loadu_si128(src + 1), zero);
+    __m128i unlit2 = _mm_cmpeq_epi32(_mm_loadu_si128(src + 2), zero);
+    __m128i unlit3 = _mm_cmpeq_epi32(_mm_loadu_si128(src + 3), zero);
+    __m128i unlit = _mm_packs_epi16(_mm_packs_epi32(unlit0, unlit1),
+                                    _mm_packs_epi32(unlit2, unlit3));
+
+    unsigned int lit = ~_mm_movemask_epi8(unlit) & 0xFFFFu;
+    packed[i / 8] = lit & 0xFFu;
+    packed[i / 8 + 1] = lit >> 8u;
+  }
+}
+
+// 16 packed bits -> 16 bytes of 0x00 (unlit) or 0xFF (lit).
+static inline __m128i LitMask(uint8_t const* packed) {
+  const __m128i bits = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32,
+                                    16, 8, 4, 2, 1);
+  __m128i spread = _mm_unpacklo_epi64(_mm_set1_epi8(packed[0]),
+                                      _mm_set1_epi8(packed[1]));
+  return _mm_cmpeq_epi8(_mm_and_si128(spread, bits), bits);
+}
+
+static void UnpackUint8(uint8_t const* packed, uint8_t* out) {
+  const __m128i one = _mm_set1_epi8(1);
+
+  for (unsigned int i = 0; i < PX_COUNT; i += 16) {
+    __m128i lit = LitMask(packed + i / 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_and_si128(lit, one));
+  }
+}
+
+static void UnpackFloat(uint8_t const* packed, float* out) {
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  for (unsigned int i = 0; i < PX_COUNT; i += 16) {
+    __m128i lit = LitMask(packed + i / 8);
+
+    // Widen each mask byte to a 32-bit all-ones/all-zeros lane, then use it
+    // to select 1.0f.
+    __m128i wordLo = _mm_unpacklo_epi8(lit, lit);
+    __m128i wordHi = _mm_unpackhi_epi8(lit, lit);
+    __m128i lanes[4] = {
+        _mm_unpacklo_epi16(wordLo, wordLo), _mm_unpackhi_epi16(wordLo, wordLo),
+        _mm_unpacklo_epi16(wordHi, wordHi), _mm_unpackhi_epi16(wordHi, wordHi)};
+
+    for (unsigned int j = 0; j < 4; j++) {
+      _mm_storeu_ps(out + i + j * 4,
+                    _mm_and_ps(_mm_castsi128_ps(lanes[j]), one));
+    }
+  }
+}
+
+#else
+
+static void Pack(uint32_t const* video, uint8_t* packed) {
+  std::memset(packed, 0, OBS_PACKED_BYTES);
+  for (unsigned int i = 0; i < PX_COUNT; i++) {
+    if (video[i]) {
+      packed[i / 8] |= 1u << (i % 8);
+    }
+  }
+}
+
+static void UnpackUint8(uint8_t const* packed, uint8_t* out) {
+  for (unsigned int i = 0; i < PX_COUNT; i++) {
+    out[i] = (packed[i / 8] >> (i % 8)) & 1u;
+  }
+}
+
+static void UnpackFloat(uint8_t const* packed, float* out) {
+  for (unsigned int i = 0; i < PX_COUNT; i++) {
+    out[i] = (packed[i / 8] >> (i % 8)) & 1u ? 1.0f : 0.0f;
+  }
+}
+
+#endif
+
+// ========== Observation ==========
+
+Observation::Observation(ObsFormat format, unsigned int stack, bool maxPool)
+    : format(format), stack(std::max(1u, stack)), maxPool(maxPool) {
+  // Max-pooling the oldest stacked frame needs one more frame behind it.
+  frames = this->stack + (maxPool ? 1 : 0);
+  history.assign(frames * OBS_PACKED_BYTES, 0);
+}
+
+size_t Observation::FrameBytes() const {
+  switch (format) {
+    case ObsFormat::PACKED_BITS:
+      return OBS_PACKED_BYTES;
+    case ObsFormat::UINT8:
+      return PX_COUNT;
+    default:
+      return PX_COUNT * sizeof(float);
+  }
+}
+
+size_t Observation::Bytes() const { return FrameBytes() * stack; }
+
+void Observation::Push(uint32_t const* video) {
+  newest = (newest + 1) % frames;
+  Pack(video, &history[newest * OBS_PACKED_BYTES]);
+}
+
+void Observation::Reset() {
+  std::fill(history.begin(), history.end(), 0);
+  newest = 0;
+}
+
+void Observation::Get(unsigned int age, uint8_t* packed) const {
+  unsigned int slot = (newest + frames - age) % frames;
+  std::memcpy(packed, &history[slot * OBS_PACKED_BYTES], OBS_PACKED_BYTES);
+
+  if (maxPool) {
+    uint8_t const* before =
+        &history[((slot + frames - 1) % frames) * OBS_PACKED_BYTES];
+    for (unsigned int i = 0; i < OBS_PACKED_BYTES; i++) {
+      packed[i] |= before[i];
+    }
+  }
+}
+
+void Observation::Write(void* out) const {
+  auto* dst = static_cast<uint8_t*>(out);
+  PackedFrame packed;
+
+  // Oldest first, so the newest frame is the last channel.
+  for (unsigned int s = 0; s < stack; s++) {
+    Get(stack - 1 - s, packed);
+
+    switch (format) {
+      case ObsFormat::PACKED_BITS:
+        std::memcpy(dst, packed, OBS_PACKED_BYTES);
+        break;
+      case ObsFormat::UINT8:
+        UnpackUint8(packed, dst);
+        break;
+      case ObsFormat::FLOAT32:
+        UnpackFloat(packed, reinterpret_cast<float*>(dst));
+        break;
+    }
+
+    dst += FrameBytes();
+  }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "chip8.hpp"
+
+// Compact observations for machine learning.
+//
+// Video() is 8 KiB of RGBA per frame for what is really 2048 bits. This turns
+// frames into the layouts training code wants, written straight into a
+// buffer the caller owns (a numpy array, a tensor, shared memory...):
+//
+//   PACKED_BITS  256 bytes per frame. Row-major, 8 bytes per row, pixel x of
+//                a row is bit (x % 8) of byte (x / 8), i.e. little-endian bit
+//                order (numpy: unpackbits(..., bitorder="little")).
+//   UINT8        2048 bytes per frame, one 0 or 1 per pixel.
+//   FLOAT32      2048 floats per frame, 0.0f or 1.0f.
+//
+// Frames are kept internally as packed bits, so history is cheap. Optionally:
+//   - max-pool each frame with the one before it (a bitwise OR here), which
+//     brings back sprites that were XOR-erased between frames;
+//   - stack the last "stack" frames, oldest first, newest last. Frames from
+//     before the first Push() are blank.
+//
+// Packing and unpacking work on 16 pixels at a time with SSE2, with a plain
+// loop as fallback on other CPUs.
+enum class ObsFormat : uint8_t { PACKED_BITS, UINT8, FLOAT32 };
+
+const unsigned int OBS_PACKED_BYTES = PX_WIDTH * PX_HEIGHT / 8;
+
+class Observation {
+ public:
+  explicit Observation(ObsFormat format, unsigned int stack = 1,
+                       bool maxPool = false);
+
+  // Size of one frame, and of a whole (stacked) observation, in bytes.
+  size_t FrameBytes() const;
+  size_t Bytes() const;
+
+  // Record a new frame (Chip8::Video()). Call once per step or per frame.
+  void Push(uint32_t const* video);
+
+  // Write the current observation, Bytes() long, into "out". For FLOAT32
+  // "out" must be suitably aligned for float.
+  void Write(void* out) const;
+
+  // Forget all frames, e.g. at the start of an episode.
+  void Reset();
+
+ private:
+  typedef uint8_t PackedFrame[OBS_PACKED_BYTES];
+
+  // Frame "age" ago (0 = newest), already max-pooled if enabled.
+  void Get(unsigned int age, uint8_t* packed) const;
+
+  ObsFormat format;
+  unsigned int stack;
+  bool maxPool;
+
+  // Ring of the most recent frames, newest at "newest".
+  std::vector<uint8_t> history;
+  unsigned int frames;
+  unsigned int newest{};
+};
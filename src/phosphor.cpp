@@ -0,0 +1,100 @@
+#include "phosphor.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PHOSPHOR_SSE2 1
+#endif
+
+const unsigned int PX_COUNT = PX_WIDTH * PX_HEIGHT;
+
+Phosphor::Phosphor(uint8_t decay) : decay(decay) {}
+
+void Phosphor::SetColors(uint32_t off, uint32_t on) {
+  for (unsigned int level = 0; level < 256; level++) {
+    uint32_t color = 0;
+    for (unsigned int shift = 0; shift < 32; shift += 8) {
+      uint32_t from = (off >> shift) & 0xFFu;
+      uint32_t to = (on >> shift) & 0xFFu;
+      color |= ((from * (255 - level) + to * level) / 255) << shift;
+    }
+    colors[level] = color;
+  }
+  tinted = true;
+}
+
+#ifdef PHOSPHOR_SSE2
+
+void Phosphor::Apply(uint32_t const* video, uint32_t* out) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi32(-1);
+  const __m128i decayVec = _mm_set1_epi16(decay);
+  const __m128i alpha = _mm_set1_epi32(0xFF);
+
+  // 16 pixels per step: 4 loads of 4 RGBA pixels in, 1 byte vector of
+  // intensities in the middle, 4 stores of 4 RGBA pixels out.
+  for (unsigned int i = 0; i < PX_COUNT; i += 16) {
+    auto const* src = reinterpret_cast<__m128i const*>(video + i);
+
+    // Pixels are either 0x00000000 or 0xFFFFFFFF. Compare against zero to get
+    // 0xFFFFFFFF for every *unlit* pixel, then narrow 32-bit -> 16 -> 8 bit
+    // with signed saturation (0xFFFFFFFF is -1, which stays -1 = 0xFF).
+    __m128i unlit0 = _mm_cmpeq_epi32(_mm_loadu_si128(src + 0), zero);
+    __m128i unlit1 = _mm_cmpeq_epi32(_mm_loadu_si128(src + 1), zero);
+    __m128i unlit2 = _mm_cmpeq_epi32(_mm_loadu_si128(src + 2), zero);
+    __m128i unlit3 = _mm_cmpeq_epi32(_mm_loadu_si128(src + 3), zero);
+    __m128i unlit = _mm_packs_epi16(_mm_packs_epi32(unlit0, unlit1),
+                                    _mm_packs_epi32(unlit2, unlit3));
+    __m128i lit = _mm_xor_si128(unlit, ones);
+
+    // level = level * decay / 256, done in 16-bit lanes so it can't overflow.
+    auto* levelPtr = reinterpret_cast<__m128i*>(intensity + i);
+    __m128i level = _mm_load_si128(levelPtr);
+    __m128i levelLo = _mm_unpacklo_epi8(level, zero);
+    __m128i levelHi = _mm_unpackhi_epi8(level, zero);
+    levelLo = _mm_srli_epi16(_mm_mullo_epi16(levelLo, decayVec), 8);
+    levelHi = _mm_srli_epi16(_mm_mullo_epi16(levelHi, decayVec), 8);
+    level = _mm_packus_epi16(levelLo, levelHi);
+
+    // Lit pixels jump straight back to full brightness.
+    level = _mm_max_epu8(level, lit);
+    _mm_store_si128(levelPtr, level);
+
+    if (tinted) {
+      for (unsigned int j = 0; j < 16; j++) {
+        out[i + j] = colors[intensity[i + j]];
+      }
+      continue;
+    }
+
+    // Widen each byte "i" to 0xiiiiiiii, then force alpha (lowest byte of
+    // RGBA8888) to 0xFF.
+    __m128i wordLo = _mm_unpacklo_epi8(level, level);
+    __m128i wordHi = _mm_unpackhi_epi8(level, level);
+    auto* dst = reinterpret_cast<__m128i*>(out + i);
+    _mm_storeu_si128(dst + 0,
+                     _mm_or_si128(_mm_unpacklo_epi16(wordLo, wordLo), alpha));
+    _mm_storeu_si128(dst + 1,
+                     _mm_or_si128(_mm_unpackhi_epi16(wordLo, wordLo), alpha));
+    _mm_storeu_si128(dst + 2,
+                     _mm_or_si128(_mm_unpacklo_epi16(wordHi, wordHi), alpha));
+    _mm_storeu_si128(dst + 3,
+                     _mm_or_si128(_mm_unpackhi_epi16(wordHi, wordHi), alpha));
+  }
+}
+
+#else
+
+void Phosphor::Apply(uint32_t const* video, uint32_t* out) {
+  for (unsigned int i = 0; i < PX_COUNT; i++) {
+    uint8_t level = (intensity[i] * decay) >> 8u;
+
+    if (video[i]) {
+      level = 0xFFu;
+    }
+
+    intensity[i] = level;
+    out[i] = tinted ? colors[level] : (level * 0x01010100u) | 0xFFu;
+  }
+}
+
+#endif
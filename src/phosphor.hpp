@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#include "chip8.hpp"
+
+// Phosphor persistence (anti-flicker) filter.
+//
+// CHIP-8 games move sprites by XOR-erasing and redrawing them with Dxyn, so a
+// sprite is often missing from the frame that happens to get presented. A CRT
+// hides this because its phosphor keeps glowing for a while after the beam
+// leaves. We fake that here: every pixel has an intensity that jumps to full
+// when the pixel is lit, and fades by "decay" each presented frame when it
+// isn't.
+//
+// Apply() is meant to be called only when a frame is presented, never per
+// Cycle(). It works on 16 pixels per step with SSE2 (about 128 steps for the
+// whole 64x32 screen), with a plain loop as fallback on other CPUs.
+class Phosphor {
+ public:
+  // decay: how much intensity survives each frame, out of 256.
+  // 0 turns persistence off, 0xC0 keeps 75% per frame.
+  explicit Phosphor(uint8_t decay = 0xC0);
+
+  // Blend the new frame into the intensity buffer and write the result as
+  // RGBA8888 greyscale into "out", ready for Platform::Update.
+  void Apply(uint32_t const* video, uint32_t* out);
+
+  // Fade from "off" to "on" (RGBA8888) instead of black to white. Output
+  // then goes through a 256-entry table after the blend.
+  void SetColors(uint32_t off, uint32_t on);
+
+ private:
+  uint8_t decay;
+
+  bool tinted{};
+  uint32_t colors[256]{};
+
+  // One byte of brightness (0x00 to 0xFF) per pixel.
+  alignas(16) uint8_t intensity[PX_WIDTH * PX_HEIGHT]{};
+};
@@ -1,10 +1,82 @@
 #include "platform.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 #include <SDL2/SDL.h>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PLATFORM_SSE2 1
+#endif
+
+#include "audio.hpp"
+#include "telemetry.hpp"
+
+static_assert(HIRES_WIDTH == 2 * PX_WIDTH && HIRES_HEIGHT == 2 * PX_HEIGHT,
+              "lo-res pixels are drawn as 2x2 in a hi-res tile");
+
+#ifdef PLATFORM_SSE2
+
+// Spread 16 bits to 16 byte masks (as in observation.cpp, but leftmost pixel
+// in the top bit, as Chip8 packs them), widen those to pixel masks and pick
+// palette[1] where set, palette[0] elsewhere. One word is 64 pixels.
+static void ExpandRow(uint64_t bits, uint32_t const* palette, uint32_t* out) {
+  const __m128i bitMasks = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4,
+                                        8, 16, 32, 64, -128);
+  const __m128i off = _mm_set1_epi32(static_cast<int>(palette[0]));
+  const __m128i on = _mm_set1_epi32(static_cast<int>(palette[1]));
+
+  for (unsigned int x = 0; x < 64; x += 16) {
+    __m128i spread = _mm_unpacklo_epi64(
+        _mm_set1_epi8(static_cast<char>(bits >> (56 - x))),
+        _mm_set1_epi8(static_cast<char>(bits >> (48 - x))));
+    __m128i lit = _mm_cmpeq_epi8(_mm_and_si128(spread, bitMasks), bitMasks);
+    __m128i litLo = _mm_unpacklo_epi8(lit, lit);
+    __m128i litHi = _mm_unpackhi_epi8(lit, lit);
+    __m128i masks[4] = {
+        _mm_unpacklo_epi16(litLo, litLo), _mm_unpackhi_epi16(litLo, litLo),
+        _mm_unpacklo_epi16(litHi, litHi), _mm_unpackhi_epi16(litHi, litHi)};
+
+    auto* dst = reinterpret_cast<__m128i*>(out + x);
+    for (int i = 0; i < 4; i++) {
+      _mm_storeu_si128(dst + i, _mm_or_si128(_mm_and_si128(masks[i], on),
+                                             _mm_andnot_si128(masks[i], off)));
+    }
+  }
+}
+
+#else
+
+static void ExpandRow(uint64_t bits, uint32_t const* palette, uint32_t* out) {
+  for (unsigned int x = 0; x < 64; x++) {
+    out[x] = palette[(bits >> (63 - x)) & 1u];
+  }
+}
+
+#endif
+
+// Each of 32 pixels twice, for drawing a lo-res row at hi-res: bit i goes
+// to bits 2i and 2i + 1.
+static uint64_t DoubleBits(uint32_t half) {
+  uint64_t bits = half;
+  bits = (bits | (bits << 16)) & 0x0000FFFF0000FFFFull;
+  bits = (bits | (bits << 8)) & 0x00FF00FF00FF00FFull;
+  bits = (bits | (bits << 4)) & 0x0F0F0F0F0F0F0F0Full;
+  bits = (bits | (bits << 2)) & 0x3333333333333333ull;
+  bits = (bits | (bits << 1)) & 0x5555555555555555ull;
+  return bits | (bits << 1);
+}
+
+// Runs on SDL's audio thread. Beeper::Render never locks or allocates.
+static void AudioCallback(void* userdata, Uint8* stream, int len) {
+  auto* beeper = static_cast<Beeper*>(userdata);
+  beeper->Render(reinterpret_cast<int16_t*>(stream), len / sizeof(int16_t));
+}
+
 Platform::Platform(char const* title, int windowWidth, int windowHeight,
                    int textureWidth, int textureHeight) {
-  SDL_Init(SDL_INIT_VIDEO);
+  SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO);
 
   window = SDL_CreateWindow(title, 0, 0, windowWidth, windowHeight,
                             SDL_WINDOW_SHOWN);
@@ -14,28 +86,211 @@ Platform::Platform(char const* title, int windowWidth, int windowHeight,
   texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,
                               SDL_TEXTUREACCESS_STREAMING, textureWidth,
                               textureHeight);
+
+  tilesAcross = std::max(1, textureWidth / static_cast<int>(HIRES_WIDTH));
+  tilesDown = std::max(1, textureHeight / static_cast<int>(HIRES_HEIGHT));
+  shownRows.resize(tilesAcross * tilesDown * HIRES_HEIGHT * DISPLAY_WORDS);
+  tileShown.resize(tilesAcross * tilesDown);
+  tileHiRes.resize(tilesAcross * tilesDown);
 }
 
 Platform::~Platform() {
+  if (audioDevice) {
+    SDL_CloseAudioDevice(audioDevice);
+  }
   SDL_DestroyTexture(texture);
   SDL_DestroyRenderer(renderer);
   SDL_DestroyWindow(window);
   SDL_Quit();
 }
 
-void Platform::Update(void const* buffer, int pitch) {
-  SDL_UpdateTexture(texture, nullptr, buffer, pitch);
+void Platform::Update(void const* buffer, int width, int height, int pitch) {
+  SDL_Rect area{0, 0, width, height};
+  SDL_UpdateTexture(texture, &area, buffer, pitch);
+  sourceWidth = width;
+  sourceHeight = height;
+  tileShown.assign(tileShown.size(), false);
+  Present();
+}
+
+void Platform::UpdateMono(Chip8 const& chip8) {
+  UploadMono(0, chip8);
+  Present();
+}
+
+void Platform::UploadMono(unsigned int tile, Chip8 const& chip8) {
+  if (tile >= tileShown.size()) {
+    return;
+  }
+  sourceWidth = 0;
+  sourceHeight = 0;
+
+  bool hires = chip8.HiRes();
+  int height = static_cast<int>(chip8.DisplayHeight());
+  // Texture rows per display row: lo-res pixels are drawn 2x2.
+  int scale = hires ? 1 : 2;
+  size_t rowBytes = DISPLAY_WORDS * sizeof(uint64_t);
+
+  uint64_t const* rows = chip8.DisplayRows();
+  uint64_t* shown = &shownRows[tile * HIRES_HEIGHT * DISPLAY_WORDS];
+  bool whole = !tileShown[tile] || tileHiRes[tile] != hires;
+  int first = height;
+  int last = -1;
+
+  for (int y = 0; y < height; y++) {
+    if (whole || std::memcmp(rows + y * DISPLAY_WORDS,
+                             shown + y * DISPLAY_WORDS, rowBytes) != 0) {
+      first = std::min(first, y);
+      last = y;
+    }
+  }
+
+  // Locked texture memory is write-only and starts out undefined, so every
+  // row of the locked band is written, changed or not.
+  if (last >= first) {
+    SDL_Rect band{static_cast<int>(tile % tilesAcross * HIRES_WIDTH),
+                  static_cast<int>(tile / tilesAcross * HIRES_HEIGHT) +
+                      first * scale,
+                  static_cast<int>(HIRES_WIDTH), (last - first + 1) * scale};
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, &band, &pixels, &pitch) == 0) {
+      for (int y = first; y <= last; y++) {
+        uint64_t const* row = rows + y * DISPLAY_WORDS;
+        auto* out = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(pixels) +
+                                                (y - first) * scale * pitch);
+        if (hires) {
+          ExpandRow(row[0], palette, out);
+          ExpandRow(row[1], palette, out + 64);
+        } else {
+          ExpandRow(DoubleBits(static_cast<uint32_t>(row[0] >> 32)), palette,
+                    out);
+          ExpandRow(DoubleBits(static_cast<uint32_t>(row[0])), palette,
+                    out + 64);
+          std::memcpy(reinterpret_cast<uint8_t*>(out) + pitch, out,
+                      HIRES_WIDTH * sizeof(uint32_t));
+        }
+        std::memcpy(shown + y * DISPLAY_WORDS, row, rowBytes);
+      }
+      SDL_UnlockTexture(texture);
+      tileShown[tile] = true;
+      tileHiRes[tile] = hires;
+    }
+  }
+}
+
+void Platform::SetPalette(uint32_t off, uint32_t on) {
+  palette[0] = off;
+  palette[1] = on;
+  tileShown.assign(tileShown.size(), false);
+}
+
+void Platform::Present() {
   SDL_RenderClear(renderer);
-  SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+  if (sourceWidth > 0) {
+    SDL_Rect source{0, 0, sourceWidth, sourceHeight};
+    SDL_RenderCopy(renderer, texture, &source, nullptr);
+  } else {
+    SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+  }
+
+  if (tilesAcross * tilesDown > 1) {
+    int width, height;
+    SDL_GetRendererOutputSize(renderer, &width, &height);
+    SDL_SetRenderDrawColor(renderer, 0x40, 0x40, 0x40, 0xFF);
+    for (int i = 1; i < tilesAcross; i++) {
+      int x = i * width / tilesAcross;
+      SDL_RenderDrawLine(renderer, x, 0, x, height);
+    }
+    for (int i = 1; i < tilesDown; i++) {
+      int y = i * height / tilesDown;
+      SDL_RenderDrawLine(renderer, 0, y, width, y);
+    }
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
+  }
+
+  if (!overlay.empty()) {
+    int width, height;
+    SDL_GetRendererOutputSize(renderer, &width, &height);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+    const int ROW_HEIGHT = 6;
+    for (size_t i = 0; i < overlay.size(); i++) {
+      SDL_Rect tail{0, static_cast<int>(i) * (ROW_HEIGHT + 2),
+                    static_cast<int>(overlay[i].tail * width), ROW_HEIGHT};
+      SDL_Rect median = tail;
+      median.w = static_cast<int>(overlay[i].median * width);
+
+      SDL_SetRenderDrawColor(renderer, 0xFF, 0x40, 0x40, 0x90);
+      SDL_RenderFillRect(renderer, &tail);
+      SDL_SetRenderDrawColor(renderer, 0x40, 0xFF, 0x40, 0xD0);
+      SDL_RenderFillRect(renderer, &median);
+    }
+
+    // Mark the middle of the scale, which the caller sets to its budget.
+    SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0x40, 0xFF);
+    SDL_RenderDrawLine(renderer, width / 2, 0, width / 2,
+                       static_cast<int>(overlay.size()) * (ROW_HEIGHT + 2));
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0xFF);
+  }
+
   SDL_RenderPresent(renderer);
 }
 
+bool Platform::StartAudio(Beeper* beeper) {
+  SDL_AudioSpec want{};
+  want.freq = AUDIO_SAMPLE_RATE;
+  want.format = AUDIO_S16SYS;
+  want.channels = 1;
+  // 512 samples is about 12 ms at 44.1 kHz.
+  want.samples = 512;
+  want.callback = AudioCallback;
+  want.userdata = beeper;
+
+  // No allowed changes: the Beeper renders exactly this format.
+  audioDevice = SDL_OpenAudioDevice(nullptr, 0, &want, nullptr, 0);
+  if (!audioDevice) {
+    return false;
+  }
+
+  SDL_PauseAudioDevice(audioDevice, 0);
+  return true;
+}
+
+void Platform::SetTitle(char const* title) {
+  SDL_SetWindowTitle(window, title);
+}
+
+bool Platform::FastForwardHeld() const { return fastForward; }
+
+int Platform::TakeSeekSteps() {
+  int steps = seekSteps;
+  seekSteps = 0;
+  return steps;
+}
+
+void Platform::SetTelemetry(Telemetry* telemetry) {
+  this->telemetry = telemetry;
+}
+
+void Platform::SetOverlay(std::vector<OverlayBar> const& bars) {
+  overlay = bars;
+}
+
 bool Platform::ProcessInput(uint8_t* keys) {
   bool quit = false;
 
   SDL_Event event;
 
   while (SDL_PollEvent(&event)) {
+    if (telemetry &&
+        (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) &&
+        !event.key.repeat) {
+      // SDL timestamps are in milliseconds.
+      telemetry->Record(Metric::INPUT_LATENCY,
+                        (SDL_GetTicks() - event.key.timestamp) * 1000000ull);
+    }
+
     switch (event.type) {
       case SDL_QUIT: {
         quit = true;
@@ -47,6 +302,18 @@ bool Platform::ProcessInput(uint8_t* keys) {
             quit = true;
           } break;
 
+          case SDLK_TAB: {
+            fastForward = true;
+          } break;
+
+          case SDLK_LEFT: {
+            seekSteps--;
+          } break;
+
+          case SDLK_RIGHT: {
+            seekSteps++;
+          } break;
+
           case SDLK_x: {
             keys[0] = 1;
           } break;
@@ -115,6 +382,10 @@ bool Platform::ProcessInput(uint8_t* keys) {
 
       case SDL_KEYUP: {
         switch (event.key.keysym.sym) {
+          case SDLK_TAB: {
+            fastForward = false;
+          } break;
+
           case SDLK_x: {
             keys[0] = 0;
           } break;
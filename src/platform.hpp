@@ -1,7 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
+#include "chip8.hpp"
+
+class Beeper;
+class Telemetry;
 class SDL_Window;
 class SDL_Renderer;
 class SDL_Texture;
@@ -11,11 +16,84 @@ class Platform {
   Platform(char const* title, int windowWidth, int windowHeight,
            int textureWidth, int textureHeight);
   ~Platform();
-  void Update(void const* buffer, int pitch);
+
+  // Present a full-colour RGBA8888 frame of width x height (e.g. from
+  // Phosphor), copying all of it into the top left of the texture and
+  // stretching just that part over the window.
+  void Update(void const* buffer, int width, int height, int pitch);
+
+  // Present the machine's own display, i.e. UploadMono(0, chip8) then
+  // Present().
+  void UpdateMono(Chip8 const& chip8);
+
+  // Write one machine's display into its tile of the texture without
+  // presenting. The texture is a grid of HIRES_WIDTH x HIRES_HEIGHT tiles,
+  // filled row by row (one tile for a single machine); lo-res displays are
+  // drawn 2x2, so switching resolution only changes what is written. The
+  // packed rows (Chip8::DisplayRows) are compared with what the tile already
+  // shows; only the band of rows that changed is locked and written, each
+  // pixel expanded through the two-colour palette.
+  void UploadMono(unsigned int tile, Chip8 const& chip8);
+
+  // Draw the texture (with lines between tiles, if there are several) and
+  // the overlay, and show the result.
+  void Present();
+
+  // Colours (RGBA8888) UploadMono() draws unlit and lit pixels in. Black
+  // and white by default.
+  void SetPalette(uint32_t off, uint32_t on);
+
   bool ProcessInput(uint8_t* keys);
+  void SetTitle(char const* title);
+
+  // True while the fast-forward key (Tab) is held down.
+  bool FastForwardHeld() const;
+
+  // Left/Right arrow presses since the last call, as -1 per Left and +1 per
+  // Right. Used to skip around in replays.
+  int TakeSeekSteps();
+
+  // Open the sound device and let its callback pull samples from "beeper".
+  // Returns false if there is no usable audio device.
+  bool StartAudio(Beeper* beeper);
+
+  // Record how long key events waited in the queue before ProcessInput
+  // handled them. Null (the default) records nothing.
+  void SetTelemetry(Telemetry* telemetry);
+
+  // Bars drawn over the picture by Update(), one row per bar from the top.
+  // Lengths are fractions of the window width: a bright bar for the typical
+  // value, a dim one behind it for the tail. Empty = no overlay.
+  struct OverlayBar {
+    float median;
+    float tail;
+  };
+  void SetOverlay(std::vector<OverlayBar> const& bars);
 
  private:
   SDL_Window* window{};
   SDL_Renderer* renderer{};
   SDL_Texture* texture{};
+  uint32_t audioDevice{};
+  bool fastForward{};
+  int seekSteps{};
+  Telemetry* telemetry{};
+  std::vector<OverlayBar> overlay;
+
+  uint32_t palette[2]{0x000000FFu, 0xFFFFFFFFu};
+
+  int tilesAcross{};
+  int tilesDown{};
+
+  // What UploadMono() last wrote, HIRES_HEIGHT rows of DISPLAY_WORDS words
+  // per tile, as Chip8 packs them, and in which mode. A tile is written
+  // whole the first time, after a mode switch, and after Update() or a
+  // palette change.
+  std::vector<uint64_t> shownRows;
+  std::vector<bool> tileShown;
+  std::vector<bool> tileHiRes;
+
+  // The part of the texture Update() last filled, 0 = all of it.
+  int sourceWidth{};
+  int sourceHeight{};
 };
@@ -0,0 +1,28 @@
+#include "quirks.hpp"
+
+#include <cstring>
+
+bool ParseVariant(char const* name, Variant& variant) {
+  if (std::strcmp(name, "chip8") == 0) {
+    variant = Variant::CHIP8;
+  } else if (std::strcmp(name, "schip") == 0) {
+    variant = Variant::SCHIP;
+  } else if (std::strcmp(name, "xochip") == 0) {
+    variant = Variant::XOCHIP;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+Variant VariantFromFilename(char const* filename) {
+  char const* ext = std::strrchr(filename, '.');
+
+  if (ext && (std::strcmp(ext, ".sc8") == 0 || std::strcmp(ext, ".sch") == 0)) {
+    return Variant::SCHIP;
+  }
+  if (ext && std::strcmp(ext, ".xo8") == 0) {
+    return Variant::XOCHIP;
+  }
+  return Variant::CHIP8;
+}
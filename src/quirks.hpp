@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+// CHIP-8 interpreters disagree on a handful of instructions, and ROMs are
+// written against one of them. Each variant below is a "quirk policy": a set
+// of compile-time constants. The instructions that differ are member
+// templates on Chip8 that read these with "if constexpr", and SetVariant()
+// points the dispatch tables at the matching instantiation. Supporting
+// several variants therefore costs no branch per instruction.
+enum class Variant : uint8_t {
+  CHIP8,   // Original COSMAC VIP interpreter.
+  SCHIP,   // SUPER-CHIP 1.1 (HP48).
+  XOCHIP,  // XO-CHIP (Octo).
+};
+
+struct Chip8Quirks {
+  // 8xy6/8xyE: shift Vy into Vx (true), or shift Vx in place (false).
+  static constexpr bool SHIFT_USES_VY = true;
+  // Fx55/Fx65: leave I pointing past the last register (I += x + 1).
+  static constexpr bool LOAD_STORE_INCREMENTS_I = true;
+  // Bnnn as Bxnn: jump to xnn + Vx instead of nnn + V0.
+  static constexpr bool JUMP_USES_VX = false;
+  // Dxyn: sprites wrap around the screen edges instead of being clipped.
+  static constexpr bool SPRITES_WRAP = false;
+  // The SUPER-CHIP display instructions: hi-res mode (00FE/00FF), scrolling
+  // (00Cn, 00FB, 00FC), 16x16 sprites (Dxy0) and the large digits (Fx30).
+  static constexpr bool SUPER_CHIP_DISPLAY = false;
+};
+
+struct SuperChipQuirks {
+  static constexpr bool SHIFT_USES_VY = false;
+  static constexpr bool LOAD_STORE_INCREMENTS_I = false;
+  static constexpr bool JUMP_USES_VX = true;
+  static constexpr bool SPRITES_WRAP = false;
+  static constexpr bool SUPER_CHIP_DISPLAY = true;
+};
+
+struct XoChipQuirks {
+  static constexpr bool SHIFT_USES_VY = true;
+  static constexpr bool LOAD_STORE_INCREMENTS_I = true;
+  static constexpr bool JUMP_USES_VX = false;
+  static constexpr bool SPRITES_WRAP = true;
+  static constexpr bool SUPER_CHIP_DISPLAY = true;
+};
+
+// Parse "chip8", "schip" or "xochip". Returns false for anything else.
+bool ParseVariant(char const* name, Variant& variant);
+
+// Guess the variant from a ROM's file extension (.ch8, .sc8, .xo8).
+// Unknown extensions are treated as plain CHIP-8.
+Variant VariantFromFilename(char const* filename);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+#include "chip8.hpp"
+
+// Runtime support for ROMs translated ahead of time by tools/chip8recomp.
+//
+// The recompiler splits a ROM into basic blocks and turns each one into a
+// C++ function. A block function runs every instruction in the block, ticks
+// the timers once per instruction (like Cycle() does), sets pc to wherever
+// the block ends up and returns how many instructions it ran.
+//
+// Instructions that aren't worth translating (drawing, BCD, key waits...)
+// are handed to the interpreter through Chip8Access::Execute, so both paths
+// share one implementation of every instruction.
+
+// Longest block the recompiler emits, in instructions.
+const unsigned int RECOMPILED_MAX_BLOCK = 32;
+
+struct RecompiledBlock {
+  uint16_t address;
+  uint16_t end;  // One past the block's last byte.
+  RecompiledFunc run;
+};
+
+struct RecompiledRom {
+  // The ROM the blocks were generated from. AttachRecompiled() refuses to
+  // use them for any other program.
+  uint8_t const *image;
+  uint16_t imageSize;
+  Variant variant;
+
+  RecompiledBlock const *blocks;
+  uint16_t blockCount;
+};
+
+// Defined by the generated translation unit, when the build includes one
+// (CMake option CHIP8_RECOMPILE_ROM).
+extern const RecompiledRom RECOMPILED_ROM;
+
+// Gives generated code direct access to the machine state.
+struct Chip8Access {
+  static uint8_t *Registers(Chip8 &c) { return c.registers; }
+  static uint8_t *Keypad(Chip8 &c) { return c.keypad; }
+  static uint16_t &Index(Chip8 &c) { return c.index; }
+  static uint16_t &Pc(Chip8 &c) { return c.pc; }
+
+  // Run one instruction through the interpreter, as if it had been fetched
+  // from "address". pc is left wherever the instruction puts it.
+  static void Execute(Chip8 &c, uint16_t address, uint16_t opcode) {
+    c.pc = address + 2;
+    c.opcode = opcode;
+    (c.*(c.table[(opcode & 0xF000u) >> 12u]))();
+  }
+
+  // Catch up on "count" instructions' worth of timer ticks at once.
+  static void Tick(Chip8 &c, unsigned int count) {
+    if (c.externalTimers) {
+      return;
+    }
+    c.delayTimer -= (c.delayTimer < count) ? c.delayTimer : count;
+    c.soundTimer -= (c.soundTimer < count) ? c.soundTimer : count;
+  }
+
+  // False once the program has written into its own code.
+  static bool CodeIntact(Chip8 const &c) { return c.codeEnd != 0; }
+
+  // True once a fault has halted the machine (FaultPolicy::HALT).
+  static bool Halted(Chip8 const &c) { return c.halted; }
+};
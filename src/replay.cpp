@@ -0,0 +1,216 @@
+#include "replay.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "byteorder.hpp"
+#include "snapshot.hpp"
+
+const unsigned int HEADER_SIZE = 4 + 4 + 1 + 4 + 4;
+const unsigned int EVENT_SIZE = 4 + 2;
+const unsigned int INDEX_ENTRY_SIZE = 8 + 4 + 8 + 4 + 2;
+const unsigned int FOOTER_SIZE = 8 + 4 + 8 + 4;
+
+static uint16_t KeyMask(Chip8 const& chip8) {
+  uint16_t keys = 0;
+  for (unsigned int key = 0; key < KEY_COUNT; key++) {
+    if (chip8.keypad[key]) {
+      keys |= 1u << key;
+    }
+  }
+  return keys;
+}
+
+// =============================
+// ========== Writer ==========
+// =============================
+
+ReplayWriter::ReplayWriter(char const* filename, Variant variant,
+                           unsigned int cyclesPerFrame,
+                           unsigned int keyframeInterval)
+    : file(filename, std::ios::binary),
+      keyframeInterval(std::max(1u, keyframeInterval)) {
+  std::string header = "C8RP";
+  PutU32LE(header, REPLAY_VERSION);
+  header += static_cast<char>(variant);
+  PutU32LE(header, this->keyframeInterval);
+  PutU32LE(header, cyclesPerFrame);
+  file.write(header.data(), header.size());
+}
+
+ReplayWriter::~ReplayWriter() { Finish(); }
+
+bool ReplayWriter::Ok() const { return static_cast<bool>(file); }
+
+void ReplayWriter::BeginFrame(Chip8 const& chip8) {
+  uint16_t keys = KeyMask(chip8);
+
+  if (frame % keyframeInterval == 0) {
+    FlushEvents();
+
+    std::string keyframe;
+    Snapshot(chip8).Encode(keyframe);
+    index.push_back({static_cast<uint64_t>(file.tellp()),
+                     static_cast<uint32_t>(keyframe.size()), 0, 0, keys});
+    file.write(keyframe.data(), keyframe.size());
+  } else if (keys != lastKeys) {
+    PutU32LE(events, frame % keyframeInterval);
+    PutU16LE(events, keys);
+  }
+
+  lastKeys = keys;
+  frame++;
+}
+
+void ReplayWriter::FlushEvents() {
+  if (index.empty()) {
+    return;
+  }
+
+  index.back().eventsOffset = file.tellp();
+  index.back().eventCount = events.size() / EVENT_SIZE;
+  file.write(events.data(), events.size());
+  events.clear();
+}
+
+void ReplayWriter::Finish() {
+  if (finished) {
+    return;
+  }
+  finished = true;
+  FlushEvents();
+
+  std::string tail;
+  for (ReplayIndexEntry const& entry : index) {
+    PutU64LE(tail, entry.keyframeOffset);
+    PutU32LE(tail, entry.keyframeSize);
+    PutU64LE(tail, entry.eventsOffset);
+    PutU32LE(tail, entry.eventCount);
+    PutU16LE(tail, entry.keys);
+  }
+
+  PutU64LE(tail, file.tellp());
+  PutU32LE(tail, index.size());
+  PutU64LE(tail, frame);
+  tail += "C8RI";
+  file.write(tail.data(), tail.size());
+  file.close();
+}
+
+// =============================
+// ========== Reader ==========
+// =============================
+
+ReplayReader::ReplayReader(char const* filename) : file(filename) {
+  data = file.Data();
+  size = file.Size();
+
+  if (size < HEADER_SIZE + FOOTER_SIZE || std::memcmp(data, "C8RP", 4) != 0 ||
+      GetU32LE(data + 4) != REPLAY_VERSION ||
+      std::memcmp(data + size - 4, "C8RI", 4) != 0) {
+    size = 0;
+    return;
+  }
+
+  variant = static_cast<Variant>(data[8]);
+  keyframeInterval = GetU32LE(data + 9);
+  cyclesPerFrame = GetU32LE(data + 13);
+
+  uint8_t const* footer = data + size - FOOTER_SIZE;
+  indexOffset = GetU64LE(footer);
+  keyframeCount = GetU32LE(footer + 8);
+  frameCount = GetU64LE(footer + 12);
+
+  if (keyframeInterval == 0 ||
+      indexOffset + uint64_t(keyframeCount) * INDEX_ENTRY_SIZE >
+          size - FOOTER_SIZE ||
+      (frameCount + keyframeInterval - 1) / keyframeInterval !=
+          keyframeCount) {
+    size = 0;
+  }
+}
+
+bool ReplayReader::Ok() const { return size != 0; }
+
+uint64_t ReplayReader::FrameCount() const { return frameCount; }
+
+unsigned int ReplayReader::KeyframeInterval() const {
+  return keyframeInterval;
+}
+
+void ReplayReader::Setup(Chip8& chip8) const {
+  chip8.SetVariant(variant);
+  chip8.SetCyclesPerFrame(cyclesPerFrame);
+}
+
+ReplayIndexEntry ReplayReader::Entry(uint64_t keyframe) const {
+  uint8_t const* p = data + indexOffset + keyframe * INDEX_ENTRY_SIZE;
+  ReplayIndexEntry entry{GetU64LE(p), GetU32LE(p + 8), GetU64LE(p + 12),
+                         GetU32LE(p + 20), GetU16LE(p + 24)};
+
+  // A damaged file loses its key changes rather than reading out of bounds.
+  if (entry.eventsOffset + uint64_t(entry.eventCount) * EVENT_SIZE >
+      indexOffset) {
+    entry.eventCount = 0;
+  }
+  return entry;
+}
+
+uint16_t ReplayReader::KeysAt(uint64_t frame) const {
+  // A recording stopped before its first frame has no keyframes at all.
+  if (keyframeCount == 0) {
+    return 0;
+  }
+  uint64_t keyframe = std::min<uint64_t>(frame / keyframeInterval,
+                                         keyframeCount - 1);
+  ReplayIndexEntry entry = Entry(keyframe);
+  uint32_t offset = frame - keyframe * keyframeInterval;
+
+  // Events are sorted by frame: find the last one at or before "frame".
+  uint8_t const* events = data + entry.eventsOffset;
+  uint32_t low = 0;
+  uint32_t high = entry.eventCount;
+  while (low < high) {
+    uint32_t middle = (low + high) / 2;
+    if (GetU32LE(events + middle * EVENT_SIZE) <= offset) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return low == 0 ? entry.keys
+                  : GetU16LE(events + (low - 1) * EVENT_SIZE + 4);
+}
+
+void ReplayReader::ApplyKeys(Chip8& chip8, uint64_t frame) const {
+  uint16_t keys = KeysAt(frame);
+  for (uint8_t key = 0; key < KEY_COUNT; key++) {
+    chip8.SetKey(key, keys & (1u << key));
+  }
+}
+
+bool ReplayReader::Seek(Chip8& chip8, uint64_t frame) const {
+  if (!Ok() || frame >= frameCount) {
+    return false;
+  }
+
+  uint64_t keyframe = frame / keyframeInterval;
+  ReplayIndexEntry entry = Entry(keyframe);
+  if (entry.keyframeOffset + entry.keyframeSize > size) {
+    return false;
+  }
+
+  Snapshot state;
+  if (!state.Decode(data + entry.keyframeOffset, entry.keyframeSize)) {
+    return false;
+  }
+  state.Restore(chip8);
+
+  for (uint64_t f = keyframe * keyframeInterval; f < frame; f++) {
+    ApplyKeys(chip8, f);
+    chip8.RunFrames(1);
+  }
+  ApplyKeys(chip8, frame);
+  return true;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+#include "mappedfile.hpp"
+
+// Replay files (.c8r): an input log plus full machine keyframes every
+// "keyframeInterval" frames, with an index at the end, so a viewer can jump
+// to any frame by restoring the keyframe at or before it and replaying at
+// most keyframeInterval - 1 frames.
+//
+// Layout (all integers little-endian):
+//
+//   Header    "C8RP", version u32, variant u8, keyframeInterval u32,
+//             cyclesPerFrame u32
+//   Segment   keyframe (Snapshot::Encode), then the key changes of the
+//             following frames up to the next keyframe, as
+//             (frame - keyframe frame) u32, keys u16 (bit k = key k)
+//   ...       one segment per keyframe
+//   Index     per keyframe: keyframe offset u64, keyframe size u32,
+//             events offset u64, event count u32, keys u16
+//   Footer    index offset u64, keyframe count u32, frame count u64, "C8RI"
+//
+// A frame is whatever the recorder calls BeginFrame() for: one Cycle() in
+// chip8emu, or RunFrames(1) for embedders.
+
+// Version 2 keyframes store the display as packed rows, with the hi-res
+// flag; version 1 files can't be read any more.
+const unsigned int REPLAY_VERSION = 2;
+
+// Where to find one keyframe and the key changes that follow it.
+struct ReplayIndexEntry {
+  uint64_t keyframeOffset;
+  uint32_t keyframeSize;
+  uint64_t eventsOffset;
+  uint32_t eventCount;
+  uint16_t keys;  // Keys held at the keyframe.
+};
+
+class ReplayWriter {
+ public:
+  ReplayWriter(char const* filename, Variant variant,
+               unsigned int cyclesPerFrame, unsigned int keyframeInterval);
+
+  // Finish() if not done yet.
+  ~ReplayWriter();
+
+  bool Ok() const;
+
+  // Call before running each frame, with the keys for that frame already
+  // set on "chip8".
+  void BeginFrame(Chip8 const& chip8);
+
+  // Write the index and footer. Nothing can be recorded afterwards.
+  void Finish();
+
+ private:
+  void FlushEvents();
+
+  std::ofstream file;
+  unsigned int keyframeInterval;
+  uint64_t frame{};
+  uint16_t lastKeys{};
+  std::string events;  // Key changes of the current segment, encoded.
+  std::vector<ReplayIndexEntry> index;
+  bool finished{};
+};
+
+class ReplayReader {
+ public:
+  // Maps the file into memory (reads it on platforms without mmap).
+  explicit ReplayReader(char const* filename);
+
+  ReplayReader(ReplayReader const&) = delete;
+  ReplayReader& operator=(ReplayReader const&) = delete;
+
+  bool Ok() const;
+  uint64_t FrameCount() const;
+  unsigned int KeyframeInterval() const;
+
+  // Set the variant and cycles per frame the replay was recorded with.
+  void Setup(Chip8& chip8) const;
+
+  // Put "chip8" (after Setup()) in the state it had at the start of "frame",
+  // with that frame's keys applied. Returns false if out of range.
+  bool Seek(Chip8& chip8, uint64_t frame) const;
+
+  // Keys held during "frame", as a mask.
+  uint16_t KeysAt(uint64_t frame) const;
+
+  // Set the keypad of "chip8" to KeysAt(frame).
+  void ApplyKeys(Chip8& chip8, uint64_t frame) const;
+
+ private:
+  ReplayIndexEntry Entry(uint64_t keyframe) const;
+
+  MappedFile file;
+  uint8_t const* data{};
+  size_t size{};  // 0 if the file isn't a valid replay.
+
+  Variant variant{};
+  unsigned int keyframeInterval{};
+  unsigned int cyclesPerFrame{};
+  uint64_t indexOffset{};
+  uint32_t keyframeCount{};
+  uint64_t frameCount{};
+};
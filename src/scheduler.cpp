@@ -0,0 +1,145 @@
+#include "scheduler.hpp"
+
+#include <algorithm>
+
+MachineTask::MachineTask(MachineTask&& other) noexcept
+    : handle(std::exchange(other.handle, nullptr)) {}
+
+MachineTask& MachineTask::operator=(MachineTask&& other) noexcept {
+  if (this != &other) {
+    if (handle) {
+      handle.destroy();
+    }
+    handle = std::exchange(other.handle, nullptr);
+  }
+  return *this;
+}
+
+MachineTask::~MachineTask() {
+  if (handle) {
+    handle.destroy();
+  }
+}
+
+void Scheduler::FrameAwaiter::await_suspend(MachineTask::Handle handle) {
+  uint32_t id = handle.promise().id;
+  if (wakeFrame == scheduler->frame + 1) {
+    scheduler->slots[id].state = State::READY;
+    scheduler->ready.push_back(id);
+  } else {
+    scheduler->slots[id].state = State::FRAMES;
+    scheduler->sleeping.emplace(wakeFrame, id);
+  }
+}
+
+void Scheduler::KeyAwaiter::await_suspend(MachineTask::Handle handle) {
+  scheduler->slots[handle.promise().id].state = State::KEY;
+  scheduler->waitingForKeys++;
+}
+
+Scheduler::~Scheduler() {
+  for (Slot& slot : slots) {
+    if (slot.handle) {
+      slot.handle.destroy();
+    }
+  }
+}
+
+Scheduler::MachineId Scheduler::Spawn(Chip8& chip8, MachineTask task) {
+  MachineId id = static_cast<MachineId>(slots.size());
+  MachineTask::Handle handle = std::exchange(task.handle, nullptr);
+  handle.promise().scheduler = this;
+  handle.promise().id = id;
+
+  slots.push_back({&chip8, handle, State::READY});
+  ready.push_back(id);
+  running++;
+  return id;
+}
+
+size_t Scheduler::RunFrame() {
+  frame++;
+
+  // Tasks resumed now queue up for the next frame in "ready", so take this
+  // frame's list out first.
+  resuming.swap(ready);
+  ready.clear();
+  while (!sleeping.empty() && sleeping.top().first <= frame) {
+    resuming.push_back(sleeping.top().second);
+    sleeping.pop();
+  }
+
+  for (MachineId id : resuming) {
+    Resume(id);
+  }
+  return resuming.size();
+}
+
+void Scheduler::Resume(MachineId id) {
+  slots[id].handle.resume();
+
+  // Looked up again: the task may have spawned others meanwhile.
+  Slot& slot = slots[id];
+  if (slot.handle.done()) {
+    slot.handle.destroy();
+    slot.handle = nullptr;
+    slot.state = State::DONE;
+    running--;
+  }
+}
+
+void Scheduler::SetKey(MachineId id, uint8_t key, bool pressed) {
+  Slot& slot = slots[id];
+  slot.chip8->SetKey(key, pressed);
+
+  if (pressed && slot.state == State::KEY) {
+    slot.state = State::READY;
+    ready.push_back(id);
+    waitingForKeys--;
+  }
+}
+
+Scheduler::FrameAwaiter Scheduler::NextFrame() { return Frames(1); }
+
+Scheduler::FrameAwaiter Scheduler::Frames(uint64_t count) {
+  return {this, frame + count, frame};
+}
+
+Scheduler::KeyAwaiter Scheduler::KeyDown() { return {this, frame}; }
+
+uint64_t Scheduler::Frame() const { return frame; }
+
+size_t Scheduler::Running() const { return running; }
+
+size_t Scheduler::WaitingForKeys() const { return waitingForKeys; }
+
+MachineTask RunMachine(Scheduler& scheduler, Chip8& chip8,
+                       unsigned int cyclesPerFrame) {
+  chip8.SetExternalTimers(true);
+
+  for (;;) {
+    chip8.RunUntilWait(cyclesPerFrame);
+
+    uint64_t passed;
+    switch (chip8.Waiting()) {
+      case WaitReason::KEY:
+        passed = co_await scheduler.KeyDown();
+        break;
+      case WaitReason::TIMER:
+        // The rest of this frame would only have spun on the timer.
+        passed = co_await scheduler.Frames(chip8.DelayTimer());
+        break;
+      case WaitReason::HALTED:
+        // A fault stopped it for good; free the slot's coroutine.
+        co_return;
+      default:
+        passed = co_await scheduler.NextFrame();
+        break;
+    }
+
+    // One tick per frame boundary crossed; 255 empties both timers.
+    for (uint64_t i = 0; i < std::min<uint64_t>(passed, 255); i++) {
+      chip8.TickTimers();
+    }
+  }
+}
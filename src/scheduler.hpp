@@ -0,0 +1,148 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "chip8.hpp"
+
+// Runs many machines on one thread, each driven by a coroutine that parks
+// itself whenever it has nothing to do:
+//
+//   co_await scheduler.NextFrame();  // until the next 60 Hz frame
+//   co_await scheduler.Frames(n);    // until n frames from now
+//   co_await scheduler.KeyDown();    // until a key goes down on this machine
+//
+// Each returns the number of frames that passed meanwhile. RunFrame()
+// advances the shared frame clock and resumes only the coroutines that are
+// due, so a parked machine costs nothing per frame: frame waits sit in a
+// heap ordered by wake-up frame, key waits in no queue at all until
+// SetKey() presses a key on that machine.
+//
+// RunMachine() is the coroutine for running a ROM; custom ones can add
+// their own per-frame work around the same awaits.
+
+class Scheduler;
+
+// The coroutine type. Only Scheduler::Spawn() can start one.
+class MachineTask {
+ public:
+  struct promise_type {
+    Scheduler* scheduler{};
+    uint32_t id{};
+
+    MachineTask get_return_object() {
+      return MachineTask(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  using Handle = std::coroutine_handle<promise_type>;
+
+  MachineTask(MachineTask&& other) noexcept;
+  MachineTask& operator=(MachineTask&& other) noexcept;
+  ~MachineTask();
+
+  MachineTask(MachineTask const&) = delete;
+  MachineTask& operator=(MachineTask const&) = delete;
+
+ private:
+  friend class Scheduler;
+
+  explicit MachineTask(Handle handle) : handle(handle) {}
+
+  Handle handle;
+};
+
+class Scheduler {
+ public:
+  using MachineId = uint32_t;
+
+  // Returned by NextFrame() and Frames().
+  struct FrameAwaiter {
+    Scheduler* scheduler;
+    uint64_t wakeFrame;
+    uint64_t parkedAt;
+
+    bool await_ready() const { return wakeFrame <= scheduler->frame; }
+    void await_suspend(MachineTask::Handle handle);
+    uint64_t await_resume() const { return scheduler->frame - parkedAt; }
+  };
+
+  // Returned by KeyDown().
+  struct KeyAwaiter {
+    Scheduler* scheduler;
+    uint64_t parkedAt;
+
+    bool await_ready() const { return false; }
+    void await_suspend(MachineTask::Handle handle);
+    uint64_t await_resume() const { return scheduler->frame - parkedAt; }
+  };
+
+  Scheduler() = default;
+  ~Scheduler();
+
+  Scheduler(Scheduler const&) = delete;
+  Scheduler& operator=(Scheduler const&) = delete;
+
+  // Take over "task", which drives "chip8". It first runs in the next
+  // RunFrame(), and is destroyed once it returns (or with the scheduler).
+  MachineId Spawn(Chip8& chip8, MachineTask task);
+
+  // Start the next frame and resume every coroutine due in it. Returns how
+  // many were resumed.
+  size_t RunFrame();
+
+  // Press or release a key on one machine. A press wakes the machine in the
+  // next frame if it is waiting in KeyDown().
+  void SetKey(MachineId id, uint8_t key, bool pressed);
+
+  FrameAwaiter NextFrame();
+  FrameAwaiter Frames(uint64_t count);
+  KeyAwaiter KeyDown();
+
+  uint64_t Frame() const;
+  size_t Running() const;       // Spawned and not finished.
+  size_t WaitingForKeys() const;
+
+ private:
+  enum class State : uint8_t { READY, FRAMES, KEY, DONE };
+
+  struct Slot {
+    Chip8* chip8;
+    MachineTask::Handle handle;
+    State state;
+  };
+
+  void Resume(MachineId id);
+
+  uint64_t frame{};
+  std::vector<Slot> slots;
+  size_t running{};
+  size_t waitingForKeys{};
+
+  // Due in the next frame, and in later frames (soonest first).
+  std::vector<MachineId> ready;
+  std::vector<MachineId> resuming;
+  std::priority_queue<std::pair<uint64_t, MachineId>,
+                      std::vector<std::pair<uint64_t, MachineId>>,
+                      std::greater<>>
+      sleeping;
+};
+
+// Run "chip8" at "cyclesPerFrame" instructions per frame with the timers
+// ticking once per frame (Chip8::SetExternalTimers). When the program waits
+// for a key or for the delay timer (see Chip8::RunUntilWait) the machine
+// parks until then, and its timers catch up on the frames that passed.
+// Finishes if a fault halts the machine (FaultPolicy::HALT).
+MachineTask RunMachine(Scheduler& scheduler, Chip8& chip8,
+                       unsigned int cyclesPerFrame);
@@ -0,0 +1,180 @@
+#include "search.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <unordered_set>
+
+// ========== Probes ==========
+
+bool Probe::Parse(std::string const& text, Probe& probe) {
+  std::string where = text;
+  size_t star = text.find('*');
+  if (star != std::string::npos) {
+    where = text.substr(0, star);
+    char* end;
+    probe.weight = std::strtod(text.c_str() + star + 1, &end);
+    if (*end != '\0') {
+      return false;
+    }
+  }
+
+  char* end;
+  if (where.size() == 2 && (where[0] == 'V' || where[0] == 'v')) {
+    probe.kind = Kind::REGISTER;
+    probe.address = std::strtoul(where.c_str() + 1, &end, 16);
+  } else {
+    probe.kind = Kind::MEMORY;
+    probe.address = std::strtoul(where.c_str(), &end, 0) % MEM_SIZE;
+  }
+  return !where.empty() && *end == '\0';
+}
+
+double Probe::Read(Chip8 const& chip8) const {
+  return kind == Kind::REGISTER ? chip8.Registers()[address]
+                                : chip8.Memory()[address];
+}
+
+double ScoreProbes(std::vector<Probe> const& probes, Chip8 const& chip8) {
+  double score = 0;
+  for (Probe const& probe : probes) {
+    score += probe.weight * probe.Read(chip8);
+  }
+  return score;
+}
+
+// ========== Thread pool ==========
+
+BeamSearch::BeamSearch(Chip8 const& root, SearchOptions const& options,
+                       Evaluator evaluate)
+    : options(options), evaluate(std::move(evaluate)), root(root) {
+  unsigned int count = std::max(1u, options.threads);
+  machines.assign(count, root);
+
+  for (unsigned int i = 0; i < count; i++) {
+    threads.emplace_back(&BeamSearch::Worker, this, i);
+  }
+}
+
+BeamSearch::~BeamSearch() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  workReady.notify_all();
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+void BeamSearch::ParallelFor(
+    unsigned int count, std::function<void(unsigned int, unsigned int)> job) {
+  if (count == 0) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  this->job = std::move(job);
+  jobCount = count;
+  nextItem = 0;
+  itemsLeft = count;
+  generation++;
+  workReady.notify_all();
+
+  workDone.wait(lock, [this] { return itemsLeft == 0; });
+}
+
+void BeamSearch::Worker(unsigned int worker) {
+  unsigned long seen = 0;
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    workReady.wait(lock, [&] { return stop || generation != seen; });
+    if (stop) {
+      return;
+    }
+    seen = generation;
+
+    // Items are whole emulation runs, so handing them out one at a time
+    // under the lock costs next to nothing.
+    while (nextItem < jobCount) {
+      unsigned int item = nextItem++;
+      lock.unlock();
+      job(worker, item);
+      lock.lock();
+
+      if (--itemsLeft == 0) {
+        workDone.notify_all();
+      }
+    }
+  }
+}
+
+// ========== Search ==========
+
+SearchResult BeamSearch::Run() {
+  SearchResult result;
+  std::vector<uint16_t> const& actions = options.actions;
+  if (actions.empty()) {
+    return result;
+  }
+
+  auto first = std::make_shared<Node>();
+  first->state = Snapshot(root);
+  first->score = evaluate(root);
+  std::vector<std::shared_ptr<Node const>> beam{first};
+
+  for (unsigned int depth = 0; depth < options.depth; depth++) {
+    std::vector<std::shared_ptr<Node const>> children(beam.size() *
+                                                      actions.size());
+
+    ParallelFor(children.size(), [&](unsigned int worker, unsigned int i) {
+      auto const& parent = beam[i / actions.size()];
+      uint16_t move = actions[i % actions.size()];
+      Chip8& machine = machines[worker];
+
+      parent->state.Restore(machine);
+      for (uint8_t key = 0; key < KEY_COUNT; key++) {
+        machine.SetKey(key, move & (1u << key));
+      }
+      machine.RunFrames(options.framesPerMove);
+
+      auto child = std::make_shared<Node>();
+      child->parent = parent;
+      child->state = Snapshot(machine, &parent->state);
+      child->move = move;
+      child->score = evaluate(machine);
+      children[i] = std::move(child);
+    });
+    result.nodes += children.size();
+
+    // Stable, so ties go to the earlier parent and action and the search is
+    // reproducible whatever the thread count.
+    std::stable_sort(children.begin(), children.end(),
+                     [](auto const& a, auto const& b) {
+                       return a->score > b->score;
+                     });
+    children.resize(std::min<size_t>(children.size(),
+                                     std::max(1u, options.beamWidth)));
+    beam = std::move(children);
+  }
+
+  result.score = beam.front()->score;
+  for (Node const* node = beam.front().get(); node->parent;
+       node = node->parent.get()) {
+    result.moves.push_back(node->move);
+  }
+  std::reverse(result.moves.begin(), result.moves.end());
+
+  // Storage of everything still alive: the beam and its ancestors.
+  std::unordered_set<Node const*> counted;
+  for (auto const& leaf : beam) {
+    for (Node const* node = leaf.get(); node && counted.insert(node).second;
+         node = node->parent.get()) {
+      result.ownBytes += node->state.OwnBytes();
+      result.fullCopyBytes += node->state.TotalBytes();
+    }
+  }
+
+  return result;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+#include "snapshot.hpp"
+
+// Input-sequence search for automated playtesting.
+//
+// Beam search over keypad inputs: every surviving node is forked once per
+// action, each child runs "framesPerMove" frames with that action's keys
+// held, and is scored by a user-supplied evaluator (typically reading a few
+// RAM bytes or registers, see Probe). The best "beamWidth" children carry
+// on to the next depth. Children are kept as Snapshots that share unchanged
+// pages with their parent.
+//
+// Expansion runs on a pool of worker threads. Each owns one working Chip8
+// that it restores a node into, runs, and snapshots again.
+
+// Reads one byte out of a machine: memory[address], or register Vx.
+struct Probe {
+  enum class Kind : uint8_t { MEMORY, REGISTER };
+
+  Kind kind = Kind::MEMORY;
+  uint16_t address{};  // or register number
+  double weight = 1.0;
+
+  // "0x2F0", "V3", optionally followed by "*weight", e.g. "V3*-10".
+  static bool Parse(std::string const& text, Probe& probe);
+
+  double Read(Chip8 const& chip8) const;
+};
+
+// Weighted sum of the probes.
+double ScoreProbes(std::vector<Probe> const& probes, Chip8 const& chip8);
+
+struct SearchOptions {
+  unsigned int depth = 10;          // Moves per sequence.
+  unsigned int framesPerMove = 30;  // Frames each move's keys are held.
+  unsigned int beamWidth = 16;
+  unsigned int threads = 1;
+
+  // Each action is a key mask (bit k = key k held). 0 = no key.
+  std::vector<uint16_t> actions;
+};
+
+struct SearchResult {
+  std::vector<uint16_t> moves;  // Best sequence found, one mask per move.
+  double score{};
+  unsigned long nodes{};  // Children evaluated.
+
+  // Snapshot storage of the final beam's nodes and their ancestors: what
+  // was actually allocated, and what full copies would have taken.
+  size_t ownBytes{};
+  size_t fullCopyBytes{};
+};
+
+class BeamSearch {
+ public:
+  typedef std::function<double(Chip8 const&)> Evaluator;
+
+  // "root" must be ready to run (ROM loaded, variant and cycles per frame
+  // set). "evaluate" is called from the worker threads.
+  BeamSearch(Chip8 const& root, SearchOptions const& options,
+             Evaluator evaluate);
+  ~BeamSearch();
+
+  SearchResult Run();
+
+ private:
+  struct Node {
+    std::shared_ptr<Node const> parent;
+    Snapshot state;
+    uint16_t move{};
+    double score{};
+  };
+
+  // Run job(worker, i) for i in [0, count) across the pool, and wait.
+  void ParallelFor(unsigned int count,
+                   std::function<void(unsigned int, unsigned int)> job);
+  void Worker(unsigned int worker);
+
+  SearchOptions options;
+  Evaluator evaluate;
+  Chip8 root;
+  std::vector<Chip8> machines;  // One per worker.
+
+  std::mutex mutex;
+  std::condition_variable workReady;
+  std::condition_variable workDone;
+  std::function<void(unsigned int, unsigned int)> job;
+  unsigned int jobCount{};
+  unsigned int nextItem{};
+  unsigned int itemsLeft{};
+  unsigned long generation{};
+  bool stop{};
+  std::vector<std::thread> threads;
+};
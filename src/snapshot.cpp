@@ -0,0 +1,190 @@
+#include "snapshot.hpp"
+
+#include <cstring>
+#include <sstream>
+
+#include "byteorder.hpp"
+
+Snapshot::Snapshot(Chip8 const& chip8, Snapshot const* parent) {
+  // Keep the parent's page if it holds the same bytes, otherwise copy them.
+  auto share = [this](uint8_t const* bytes,
+                      std::shared_ptr<Page const> const* parentPage) {
+    if (parentPage && *parentPage &&
+        std::memcmp((*parentPage)->data(), bytes, SNAPSHOT_PAGE_SIZE) == 0) {
+      return *parentPage;
+    }
+
+    auto page = std::make_shared<Page>();
+    std::memcpy(page->data(), bytes, SNAPSHOT_PAGE_SIZE);
+    ownPages++;
+    return std::shared_ptr<Page const>(std::move(page));
+  };
+
+  auto const* display = reinterpret_cast<uint8_t const*>(chip8.display);
+  for (unsigned int i = 0; i < MEMORY_PAGES; i++) {
+    memoryPages[i] = share(chip8.memory + i * SNAPSHOT_PAGE_SIZE,
+                           parent ? &parent->memoryPages[i] : nullptr);
+  }
+  for (unsigned int i = 0; i < DISPLAY_PAGES; i++) {
+    displayPages[i] = share(display + i * SNAPSHOT_PAGE_SIZE,
+                            parent ? &parent->displayPages[i] : nullptr);
+  }
+
+  std::memcpy(registers, chip8.registers, sizeof(registers));
+  std::memcpy(keypad, chip8.keypad, sizeof(keypad));
+  std::memcpy(stack, chip8.stack, sizeof(stack));
+  index = chip8.index;
+  pc = chip8.pc;
+  sp = chip8.sp;
+  delayTimer = chip8.delayTimer;
+  soundTimer = chip8.soundTimer;
+  hires = chip8.hires;
+  codeEnd = chip8.codeEnd;
+  cycleCount = chip8.cycleCount;
+  firstFault = chip8.firstFault;
+  faultCount = chip8.faultCount;
+  halted = chip8.halted;
+  randGen = chip8.randGen;
+}
+
+void Snapshot::Restore(Chip8& chip8) const {
+  auto* display = reinterpret_cast<uint8_t*>(chip8.display);
+  for (unsigned int i = 0; i < MEMORY_PAGES; i++) {
+    std::memcpy(chip8.memory + i * SNAPSHOT_PAGE_SIZE, memoryPages[i]->data(),
+                SNAPSHOT_PAGE_SIZE);
+  }
+  for (unsigned int i = 0; i < DISPLAY_PAGES; i++) {
+    std::memcpy(display + i * SNAPSHOT_PAGE_SIZE, displayPages[i]->data(),
+                SNAPSHOT_PAGE_SIZE);
+  }
+  chip8.videoStale = true;
+
+  std::memcpy(chip8.registers, registers, sizeof(registers));
+  std::memcpy(chip8.keypad, keypad, sizeof(keypad));
+  std::memcpy(chip8.stack, stack, sizeof(stack));
+  chip8.index = index;
+  chip8.pc = pc;
+  chip8.sp = sp;
+  chip8.delayTimer = delayTimer;
+  chip8.soundTimer = soundTimer;
+  chip8.hires = hires;
+  // Only meaningful to a machine that has recompiled code attached.
+  chip8.codeEnd = chip8.recompiledBlocks.empty() ? 0 : codeEnd;
+  chip8.cycleCount = cycleCount;
+  chip8.firstFault = firstFault;
+  chip8.faultCount = faultCount;
+  chip8.halted = halted;
+  chip8.wait = halted ? WaitReason::HALTED : WaitReason::NONE;
+  chip8.randGen = randGen;
+}
+
+size_t Snapshot::OwnBytes() const {
+  return ownPages * SNAPSHOT_PAGE_SIZE + sizeof(Snapshot);
+}
+
+size_t Snapshot::TotalBytes() const {
+  return (MEMORY_PAGES + DISPLAY_PAGES) * SNAPSHOT_PAGE_SIZE + sizeof(Snapshot);
+}
+
+// ========== Encoding ==========
+
+void Snapshot::Encode(std::string& out) const {
+  out.append(reinterpret_cast<char const*>(registers), sizeof(registers));
+  out.append(reinterpret_cast<char const*>(keypad), sizeof(keypad));
+  for (uint16_t entry : stack) {
+    PutU16LE(out, entry);
+  }
+  PutU16LE(out, index);
+  PutU16LE(out, pc);
+  out += static_cast<char>(sp);
+  out += static_cast<char>(delayTimer);
+  out += static_cast<char>(soundTimer);
+
+  for (auto const& page : memoryPages) {
+    out.append(reinterpret_cast<char const*>(page->data()),
+               SNAPSHOT_PAGE_SIZE);
+  }
+
+  // The rows are already one bit per pixel; only the byte order is fixed.
+  out += static_cast<char>(hires ? 1 : 0);
+  for (auto const& page : displayPages) {
+    for (unsigned int i = 0; i < SNAPSHOT_PAGE_SIZE; i += sizeof(uint64_t)) {
+      uint64_t word;
+      std::memcpy(&word, page->data() + i, sizeof(word));
+      PutU64LE(out, word);
+    }
+  }
+
+  // The engine's own text form is the only portable way to save its state.
+  std::ostringstream rng;
+  rng << randGen;
+  PutU16LE(out, rng.str().size());
+  out += rng.str();
+}
+
+bool Snapshot::Decode(uint8_t const* data, size_t size) {
+  const size_t FIXED_SIZE = REGISTER_COUNT + KEY_COUNT + STACK_LEVELS * 2 +
+                            2 + 2 + 3 + MEM_SIZE + 1 +
+                            DISPLAY_PAGES * SNAPSHOT_PAGE_SIZE + 2;
+  if (size < FIXED_SIZE) {
+    return false;
+  }
+
+  uint8_t const* p = data;
+  std::memcpy(registers, p, sizeof(registers));
+  p += sizeof(registers);
+  std::memcpy(keypad, p, sizeof(keypad));
+  p += sizeof(keypad);
+  for (uint16_t& entry : stack) {
+    entry = GetU16LE(p);
+    p += 2;
+  }
+  index = GetU16LE(p);
+  pc = GetU16LE(p + 2);
+  sp = p[4];
+  // 00EE reads stack[sp - 1]: a damaged sp would index past the stack.
+  if (sp > STACK_LEVELS) {
+    return false;
+  }
+  delayTimer = p[5];
+  soundTimer = p[6];
+  p += 7;
+
+  ownPages = 0;
+  for (auto& page : memoryPages) {
+    auto copy = std::make_shared<Page>();
+    std::memcpy(copy->data(), p, SNAPSHOT_PAGE_SIZE);
+    page = std::move(copy);
+    ownPages++;
+    p += SNAPSHOT_PAGE_SIZE;
+  }
+
+  hires = p[0] != 0;
+  p += 1;
+  for (auto& page : displayPages) {
+    auto copy = std::make_shared<Page>();
+    for (unsigned int i = 0; i < SNAPSHOT_PAGE_SIZE; i += sizeof(uint64_t)) {
+      uint64_t word = GetU64LE(p);
+      std::memcpy(copy->data() + i, &word, sizeof(word));
+      p += sizeof(uint64_t);
+    }
+    page = std::move(copy);
+    ownPages++;
+  }
+
+  size_t rngSize = GetU16LE(p);
+  p += 2;
+  if (static_cast<size_t>(p - data) + rngSize > size) {
+    return false;
+  }
+  std::istringstream rng(
+      std::string(reinterpret_cast<char const*>(p), rngSize));
+  rng >> randGen;
+
+  codeEnd = 0;
+  cycleCount = 0;
+  firstFault = {};
+  faultCount = 0;
+  halted = false;
+  return static_cast<bool>(rng);
+}
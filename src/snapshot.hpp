@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "chip8.hpp"
+
+const unsigned int SNAPSHOT_PAGE_SIZE = 256;
+
+// A saved machine state that shares unchanged pages with its parent.
+//
+// The running Chip8 keeps memory and the display as flat arrays, so the
+// interpreter never pays for an extra indirection. Saved states are stored
+// as 256-byte pages behind shared pointers instead. A snapshot taken with a
+// parent compares each page with the parent's and keeps a reference to the
+// parent's page when nothing changed. A tree of states that mostly differ in
+// a few variables and a few sprites then costs a few pages per node, not
+// 4 KiB of memory plus 1 KiB of display.
+//
+// Only the state that changes while running is saved. Restore() into a
+// machine set up the same way (same ROM, same variant), typically a copy of
+// the one the first snapshot was taken from.
+class Snapshot {
+ public:
+  Snapshot() = default;
+  explicit Snapshot(Chip8 const& chip8, Snapshot const* parent = nullptr);
+
+  void Restore(Chip8& chip8) const;
+
+  // Flat, self-contained encoding for files (little-endian, the display as
+  // its packed rows), appended to "out".
+  void Encode(std::string& out) const;
+
+  // Rebuild from Encode() output. Returns false if "data" is malformed.
+  // Recompiled code and fault records are not part of the encoding:
+  // restoring a decoded snapshot leaves the machine interpreting, with no
+  // faults and a cycle count of 0.
+  bool Decode(uint8_t const* data, size_t size);
+
+  // Bytes held in pages this snapshot allocated itself (not shared with its
+  // parent), and in all of its pages.
+  size_t OwnBytes() const;
+  size_t TotalBytes() const;
+
+ private:
+  typedef std::array<uint8_t, SNAPSHOT_PAGE_SIZE> Page;
+
+  static const unsigned int MEMORY_PAGES = MEM_SIZE / SNAPSHOT_PAGE_SIZE;
+  static const unsigned int DISPLAY_PAGES =
+      sizeof(uint64_t) * HIRES_HEIGHT * DISPLAY_WORDS / SNAPSHOT_PAGE_SIZE;
+
+  std::shared_ptr<Page const> memoryPages[MEMORY_PAGES];
+  std::shared_ptr<Page const> displayPages[DISPLAY_PAGES];
+  unsigned int ownPages{};
+
+  uint8_t registers[REGISTER_COUNT]{};
+  uint8_t keypad[KEY_COUNT]{};
+  uint16_t stack[STACK_LEVELS]{};
+  uint16_t index{};
+  uint16_t pc{};
+  uint8_t sp{};
+  uint8_t delayTimer{};
+  uint8_t soundTimer{};
+  bool hires{};
+  uint16_t codeEnd{};
+  uint64_t cycleCount{};
+  FaultInfo firstFault{};
+  uint32_t faultCount{};
+  bool halted{};
+  std::default_random_engine randGen;
+};
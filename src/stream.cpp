@@ -0,0 +1,442 @@
+#include "stream.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "byteorder.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define STREAM_POSIX 1
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+const unsigned int HELLO_SIZE = 4 + 2 + 2;
+const unsigned int FRAME_HEADER_SIZE = 1 + 4 + 2;
+const unsigned int KEY_EVENT_SIZE = 3;
+
+// (zero bytes, literal bytes, literals...) until "size" bytes are covered.
+static void EncodeRuns(uint8_t const* delta, size_t size, std::string& out) {
+  size_t i = 0;
+  while (i < size) {
+    uint8_t zeros = 0;
+    while (i < size && delta[i] == 0 && zeros < 0xFF) {
+      zeros++;
+      i++;
+    }
+    size_t start = i;
+    while (i < size && delta[i] != 0 && i - start < 0xFF) {
+      i++;
+    }
+    out += static_cast<char>(zeros);
+    out += static_cast<char>(i - start);
+    out.append(reinterpret_cast<char const*>(delta + start), i - start);
+  }
+}
+
+// XOR the runs in "data" into "frame". False if they don't add up to
+// exactly "size" bytes.
+static bool ApplyRuns(char const* data, size_t length, uint8_t* frame,
+                      size_t size) {
+  size_t i = 0;
+  size_t at = 0;
+  while (at + 2 <= length && i < size) {
+    uint8_t zeros = data[at];
+    uint8_t literals = data[at + 1];
+    at += 2;
+    if (i + zeros + literals > size || at + literals > length) {
+      return false;
+    }
+    i += zeros;
+    for (uint8_t k = 0; k < literals; k++) {
+      frame[i++] ^= data[at++];
+    }
+  }
+  return i == size && at == length;
+}
+
+// =============================
+// ========== Server ==========
+// =============================
+
+StreamServer::StreamServer(char const* path, unsigned int keyframeInterval)
+    : path(path),
+      keyframeInterval(std::max(1u, keyframeInterval)),
+      packer(ObsFormat::PACKED_BITS) {
+#ifdef STREAM_POSIX
+  sockaddr_un address{};
+  if (this->path.size() >= sizeof(address.sun_path)) {
+    return;
+  }
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, path);
+
+  listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    return;
+  }
+  unlink(path);
+  if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+          0 ||
+      listen(listenFd, 16) != 0 || pipe(wakePipe) != 0) {
+    close(listenFd);
+    listenFd = -1;
+    return;
+  }
+
+  fcntl(listenFd, F_SETFL, O_NONBLOCK);
+  fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+
+  encoder = std::thread(&StreamServer::Run, this);
+#endif
+}
+
+StreamServer::~StreamServer() {
+#ifdef STREAM_POSIX
+  if (encoder.joinable()) {
+    stopping = true;
+    [[maybe_unused]] ssize_t written = write(wakePipe[1], "", 1);
+    encoder.join();
+  }
+
+  for (Viewer const& viewer : viewers) {
+    close(viewer.fd);
+  }
+  if (listenFd >= 0) {
+    close(listenFd);
+    unlink(path.c_str());
+  }
+  for (int fd : wakePipe) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+#endif
+}
+
+bool StreamServer::Ok() const { return listenFd >= 0; }
+
+void StreamServer::Publish(uint32_t const* video) {
+  // Headless runs publish every cycle. Don't pack frames nobody watches, or
+  // while the encoder hasn't even picked up the last one: it would be
+  // replaced before being sent anyway.
+  if (viewerCount == 0 || wakePending) {
+    return;
+  }
+
+  uint8_t packed[OBS_PACKED_BYTES];
+  packer.Push(video);
+  packer.Write(packed);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::memcpy(latest, packed, sizeof(latest));
+    latestFrame = published++;
+    fresh = true;
+  }
+
+#ifdef STREAM_POSIX
+  // One wake-up byte in flight is enough; the encoder takes the newest frame.
+  if (!wakePending.exchange(true)) {
+    [[maybe_unused]] ssize_t written = write(wakePipe[1], "", 1);
+  }
+#endif
+}
+
+void StreamServer::ApplyKeys(uint8_t* keys) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (uint16_t event : keyEvents) {
+    keys[event & 0xFFu] = event >> 8u;
+  }
+  keyEvents.clear();
+}
+
+void StreamServer::Run() {
+#ifdef STREAM_POSIX
+  std::vector<pollfd> fds;
+
+  while (!stopping) {
+    fds.clear();
+    fds.push_back({wakePipe[0], POLLIN, 0});
+    fds.push_back({listenFd, POLLIN, 0});
+    for (Viewer const& viewer : viewers) {
+      short events = POLLIN;
+      if (!viewer.outbox.empty()) {
+        events |= POLLOUT;
+      }
+      fds.push_back({viewer.fd, events, 0});
+    }
+
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      continue;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      char drain[64];
+      while (read(wakePipe[0], drain, sizeof(drain)) > 0) {
+      }
+      wakePending = false;
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (fresh) {
+        std::memcpy(current, latest, sizeof(current));
+        currentFrame = latestFrame;
+        haveFrame = true;
+        fresh = false;
+      }
+    }
+
+    // Viewers that drop out are removed after this pass.
+    std::vector<bool> alive(viewers.size(), true);
+    for (size_t i = 0; i < viewers.size(); i++) {
+      short revents = fds[i + 2].revents;
+      if (revents & (POLLIN | POLLHUP | POLLERR)) {
+        alive[i] = Read(viewers[i]);
+      }
+      if (alive[i] && (revents & POLLOUT)) {
+        alive[i] = Flush(viewers[i]);
+      }
+      // Only a viewer whose socket has drained gets a frame, and then the
+      // newest one: anything published in between is skipped.
+      if (alive[i] && viewers[i].outbox.empty() && haveFrame) {
+        Encode(viewers[i]);
+        alive[i] = Flush(viewers[i]);
+      }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < viewers.size(); i++) {
+      if (!alive[i]) {
+        close(viewers[i].fd);
+      } else if (kept++ != i) {
+        viewers[kept - 1] = std::move(viewers[i]);
+      }
+    }
+    viewers.resize(kept);
+
+    if (fds[1].revents & POLLIN) {
+      Accept();
+    }
+    viewerCount = viewers.size();
+  }
+#endif
+}
+
+void StreamServer::Accept() {
+#ifdef STREAM_POSIX
+  int fd;
+  while ((fd = accept(listenFd, nullptr, nullptr)) >= 0) {
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+    Viewer viewer{};
+    viewer.fd = fd;
+    viewer.outbox = "C8FS";
+    PutU16LE(viewer.outbox, PX_WIDTH);
+    PutU16LE(viewer.outbox, PX_HEIGHT);
+    if (haveFrame) {
+      Encode(viewer);
+    }
+    if (Flush(viewer)) {
+      viewers.push_back(std::move(viewer));
+    } else {
+      close(fd);
+    }
+  }
+#endif
+}
+
+bool StreamServer::Read(Viewer& viewer) {
+#ifdef STREAM_POSIX
+  char buffer[256];
+  ssize_t count = recv(viewer.fd, buffer, sizeof(buffer), 0);
+  if (count <= 0) {
+    return count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+  viewer.inbox.append(buffer, count);
+
+  size_t at = 0;
+  std::lock_guard<std::mutex> lock(mutex);
+  for (; at + KEY_EVENT_SIZE <= viewer.inbox.size(); at += KEY_EVENT_SIZE) {
+    uint8_t key = viewer.inbox[at + 1];
+    if (viewer.inbox[at] != 'k' || key >= KEY_COUNT) {
+      return false;
+    }
+    keyEvents.push_back(key | (viewer.inbox[at + 2] ? 0x100u : 0u));
+  }
+  viewer.inbox.erase(0, at);
+  return true;
+#else
+  (void)viewer;
+  return false;
+#endif
+}
+
+bool StreamServer::Flush(Viewer& viewer) {
+#ifdef STREAM_POSIX
+  while (!viewer.outbox.empty()) {
+    ssize_t count = send(viewer.fd, viewer.outbox.data(),
+                         viewer.outbox.size(), MSG_NOSIGNAL);
+    if (count < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    viewer.outbox.erase(0, count);
+  }
+  return true;
+#else
+  (void)viewer;
+  return false;
+#endif
+}
+
+void StreamServer::Encode(Viewer& viewer) {
+  if (viewer.anySent && viewer.sentFrame == currentFrame) {
+    return;
+  }
+
+  bool keyframe = !viewer.anySent || viewer.sinceKeyframe >= keyframeInterval;
+  uint8_t delta[OBS_PACKED_BYTES];
+  bool changed = false;
+  for (unsigned int i = 0; i < OBS_PACKED_BYTES; i++) {
+    delta[i] = keyframe ? current[i] : current[i] ^ viewer.sent[i];
+    changed = changed || current[i] != viewer.sent[i];
+  }
+
+  viewer.sentFrame = currentFrame;
+  if (!keyframe && !changed) {
+    return;
+  }
+
+  std::string payload;
+  EncodeRuns(delta, OBS_PACKED_BYTES, payload);
+  viewer.outbox += keyframe ? 'K' : 'D';
+  PutU32LE(viewer.outbox, currentFrame);
+  PutU16LE(viewer.outbox, payload.size());
+  viewer.outbox += payload;
+
+  std::memcpy(viewer.sent, current, sizeof(viewer.sent));
+  viewer.anySent = true;
+  viewer.sinceKeyframe = keyframe ? 1 : viewer.sinceKeyframe + 1;
+}
+
+// =============================
+// ========== Viewer ==========
+// =============================
+
+StreamViewer::StreamViewer(char const* path) {
+#ifdef STREAM_POSIX
+  sockaddr_un address{};
+  if (std::strlen(path) >= sizeof(address.sun_path)) {
+    return;
+  }
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, path);
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return;
+  }
+  if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) !=
+      0) {
+    close(fd);
+    fd = -1;
+    return;
+  }
+  fcntl(fd, F_SETFL, O_NONBLOCK);
+  ok = true;
+#else
+  (void)path;
+#endif
+}
+
+StreamViewer::~StreamViewer() {
+#ifdef STREAM_POSIX
+  if (fd >= 0) {
+    close(fd);
+  }
+#endif
+}
+
+bool StreamViewer::Ok() const { return ok; }
+
+uint32_t StreamViewer::Frame() const { return frameNumber; }
+
+bool StreamViewer::Poll(uint32_t* video) {
+#ifdef STREAM_POSIX
+  char buffer[4096];
+  ssize_t count;
+  while (ok && (count = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+    inbox.append(buffer, count);
+  }
+  if (ok && count == 0) {
+    ok = false;
+  }
+#endif
+
+  size_t at = 0;
+  if (!greeted && inbox.size() >= HELLO_SIZE) {
+    if (inbox.compare(0, 4, "C8FS") != 0 ||
+        GetU16LE(inbox.data() + 4) != PX_WIDTH ||
+        GetU16LE(inbox.data() + 6) != PX_HEIGHT) {
+      ok = false;
+      return false;
+    }
+    greeted = true;
+    at = HELLO_SIZE;
+  }
+
+  bool decoded = false;
+  while (greeted && at + FRAME_HEADER_SIZE <= inbox.size()) {
+    char type = inbox[at];
+    uint16_t size = GetU16LE(inbox.data() + at + 5);
+    if (at + FRAME_HEADER_SIZE + size > inbox.size()) {
+      break;
+    }
+
+    if (type == 'K') {
+      std::memset(frame, 0, sizeof(frame));
+    }
+    if ((type != 'K' && type != 'D') ||
+        !ApplyRuns(inbox.data() + at + FRAME_HEADER_SIZE, size, frame,
+                   sizeof(frame))) {
+      ok = false;
+      return decoded;
+    }
+    frameNumber = GetU32LE(inbox.data() + at + 1);
+    at += FRAME_HEADER_SIZE + size;
+    decoded = true;
+  }
+  inbox.erase(0, at);
+
+  if (decoded) {
+    for (unsigned int i = 0; i < PX_WIDTH * PX_HEIGHT; i++) {
+      video[i] = (frame[i / 8] >> (i % 8)) & 1u ? 0xFFFFFFFFu : 0;
+    }
+  }
+  return decoded;
+}
+
+void StreamViewer::SendKey(uint8_t key, bool pressed) {
+#ifdef STREAM_POSIX
+  char event[KEY_EVENT_SIZE] = {'k', static_cast<char>(key),
+                                static_cast<char>(pressed)};
+  if (ok && send(fd, event, sizeof(event), MSG_NOSIGNAL) != sizeof(event)) {
+    ok = false;
+  }
+#else
+  (void)key;
+  (void)pressed;
+#endif
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+#include "observation.hpp"
+
+// Framebuffer streaming over a Unix domain socket, for watching many
+// (headless) emulators from one dashboard process.
+//
+// Protocol, all integers little-endian:
+//
+//   Server -> viewer, once   "C8FS", width u16, height u16
+//   Server -> viewer, frames type u8 ('K' keyframe, 'D' delta), frame u32,
+//                            payload size u16, payload
+//   Viewer -> server         'k', key u8, pressed u8
+//
+// A payload is the frame in ObsFormat::PACKED_BITS layout (256 bytes),
+// XORed with the last frame sent to that viewer (with a blank frame for
+// keyframes), then run-length encoded as pairs of (zero bytes u8,
+// literal bytes u8, the literals) until all 256 bytes are covered. Frame
+// numbers count the frames handed to the encoder, so gaps show how many a
+// viewer skipped.
+//
+// Unchanged frames aren't sent at all. A viewer gets a keyframe when it
+// connects and then every "keyframeInterval" frames it is sent.
+//
+// Encoding and socket I/O happen on a thread of their own. Publish() only
+// packs the frame and hands it over; frames offered while the encoder is
+// still waking up for the previous one are dropped without being packed.
+// A viewer that can't keep up is sent the newest frame once its socket
+// drains, skipping everything in between. The emulation thread never waits
+// for a viewer.
+class StreamServer {
+ public:
+  // Listens on "path", replacing any stale socket file there.
+  explicit StreamServer(char const* path, unsigned int keyframeInterval = 60);
+
+  // Disconnects every viewer and removes the socket file.
+  ~StreamServer();
+
+  StreamServer(StreamServer const&) = delete;
+  StreamServer& operator=(StreamServer const&) = delete;
+
+  // False if the socket couldn't be set up (or on platforms without Unix
+  // domain sockets).
+  bool Ok() const;
+
+  // Offer a frame (Chip8::Video()) to the viewers. Returns at once when
+  // nobody is connected.
+  void Publish(uint32_t const* video);
+
+  // Apply key presses and releases received from viewers since the last
+  // call to "keys" (KEY_COUNT entries).
+  void ApplyKeys(uint8_t* keys);
+
+ private:
+  struct Viewer {
+    int fd;
+    uint8_t sent[OBS_PACKED_BYTES];  // What the viewer has now.
+    uint32_t sentFrame;
+    bool anySent;
+    unsigned int sinceKeyframe;
+    std::string outbox;  // Encoded, not yet written.
+    std::string inbox;   // Partial key events.
+  };
+
+  void Run();
+  void Accept();
+  bool Read(Viewer& viewer);
+  bool Flush(Viewer& viewer);
+  void Encode(Viewer& viewer);
+
+  std::string path;
+  unsigned int keyframeInterval;
+  int listenFd{-1};
+  int wakePipe[2]{-1, -1};
+  std::thread encoder;
+  std::atomic<bool> stopping{};
+  std::atomic<bool> wakePending{};
+  std::atomic<unsigned int> viewerCount{};
+
+  // Emulation thread only.
+  Observation packer;
+  uint32_t published{};
+
+  // Guarded by "mutex": the newest frame and key events not yet applied.
+  std::mutex mutex;
+  uint8_t latest[OBS_PACKED_BYTES]{};
+  uint32_t latestFrame{};
+  bool fresh{};
+  std::vector<uint16_t> keyEvents;  // key | pressed << 8
+
+  // Encoder thread only.
+  uint8_t current[OBS_PACKED_BYTES]{};
+  uint32_t currentFrame{};
+  bool haveFrame{};
+  std::vector<Viewer> viewers;
+};
+
+// The other end: connects to a StreamServer and rebuilds its frames.
+class StreamViewer {
+ public:
+  explicit StreamViewer(char const* path);
+  ~StreamViewer();
+
+  StreamViewer(StreamViewer const&) = delete;
+  StreamViewer& operator=(StreamViewer const&) = delete;
+
+  // False once the connection is lost or the stream turns out malformed.
+  bool Ok() const;
+
+  // Decode whatever has arrived, without waiting, into "video"
+  // (PX_WIDTH * PX_HEIGHT pixels, 0 or 0xFFFFFFFF like Chip8::Video()).
+  // Returns true if a new frame was decoded.
+  bool Poll(uint32_t* video);
+
+  // Number of the newest decoded frame.
+  uint32_t Frame() const;
+
+  void SendKey(uint8_t key, bool pressed);
+
+ private:
+  int fd{-1};
+  bool ok{};
+  bool greeted{};
+  std::string inbox;
+  uint8_t frame[OBS_PACKED_BYTES]{};
+  uint32_t frameNumber{};
+};
@@ -0,0 +1,160 @@
+#include "telemetry.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <fstream>
+
+// ========== Histogram ==========
+
+unsigned int Histogram::BucketOf(uint64_t ns) {
+  // Values below SUB_BUCKETS get a bucket each. Above that, the top bit
+  // picks a power of two and the next three bits one of its 8 slices.
+  if (ns < SUB_BUCKETS) {
+    return ns;
+  }
+  unsigned int exponent = std::bit_width(ns) - 1;
+  unsigned int slice = (ns >> (exponent - 3)) & (SUB_BUCKETS - 1);
+  return (exponent - 2) * SUB_BUCKETS + slice;
+}
+
+uint64_t Histogram::BucketMidpoint(unsigned int bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return bucket;
+  }
+  unsigned int exponent = bucket / SUB_BUCKETS + 2;
+  uint64_t slice = bucket % SUB_BUCKETS;
+  uint64_t width = uint64_t(1) << (exponent - 3);
+  return ((SUB_BUCKETS + slice) << (exponent - 3)) + width / 2;
+}
+
+void Histogram::Record(uint64_t ns) {
+  buckets[BucketOf(ns)]++;
+  count++;
+  max = std::max(max, ns);
+  sum += static_cast<double>(ns);
+}
+
+void Histogram::Reset() { *this = Histogram(); }
+
+uint64_t Histogram::Count() const { return count; }
+
+uint64_t Histogram::Max() const { return max; }
+
+double Histogram::Mean() const { return count ? sum / count : 0.0; }
+
+uint64_t Histogram::Percentile(double p) const {
+  if (count == 0) {
+    return 0;
+  }
+
+  uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p * count + 0.5));
+  uint64_t seen = 0;
+  for (unsigned int bucket = 0; bucket < BUCKETS; bucket++) {
+    seen += buckets[bucket];
+    if (seen >= rank) {
+      return std::min(BucketMidpoint(bucket), max);
+    }
+  }
+  return max;
+}
+
+// ========== Telemetry ==========
+
+void Telemetry::Record(Metric metric, uint64_t ns) {
+  total[static_cast<unsigned int>(metric)].Record(ns);
+  recent[static_cast<unsigned int>(metric)].Record(ns);
+}
+
+Histogram const& Telemetry::Total(Metric metric) const {
+  return total[static_cast<unsigned int>(metric)];
+}
+
+Histogram const& Telemetry::Recent(Metric metric) const {
+  return recent[static_cast<unsigned int>(metric)];
+}
+
+void Telemetry::ResetRecent() {
+  for (Histogram& histogram : recent) {
+    histogram.Reset();
+  }
+}
+
+char const* Telemetry::Name(Metric metric) {
+  switch (metric) {
+    case Metric::EMULATION:
+      return "emulation";
+    case Metric::UPDATE:
+      return "update";
+    case Metric::PRESENT_INTERVAL:
+      return "present_interval";
+    case Metric::JITTER:
+      return "jitter";
+    case Metric::INPUT_LATENCY:
+      return "input_latency";
+    case Metric::HOST_FRAME:
+      return "host_frame";
+    default:
+      return "unknown";
+  }
+}
+
+char const* Telemetry::Name(Gauge gauge) {
+  switch (gauge) {
+    case Gauge::CYCLES_PER_FRAME:
+      return "cycles_per_frame";
+    case Gauge::PRESENT_INTERVAL:
+      return "present_interval";
+    case Gauge::CPU_LOAD:
+      return "cpu_load";
+    default:
+      return "unknown";
+  }
+}
+
+void Telemetry::SetGauge(Gauge gauge, double value) {
+  gauges[static_cast<unsigned int>(gauge)] = value;
+  gaugeSet[static_cast<unsigned int>(gauge)] = true;
+}
+
+std::string Telemetry::Json() const {
+  std::string out = "{\n";
+  char line[256];
+
+  std::string gaugeList;
+  for (unsigned int i = 0; i < GAUGE_COUNT; i++) {
+    if (gaugeSet[i]) {
+      std::snprintf(line, sizeof(line), "%s\"%s\": %g",
+                    gaugeList.empty() ? "" : ", ",
+                    Name(static_cast<Gauge>(i)), gauges[i]);
+      gaugeList += line;
+    }
+  }
+
+  for (unsigned int i = 0; i < METRIC_COUNT; i++) {
+    Histogram const& h = total[i];
+    std::snprintf(line, sizeof(line),
+                  "  \"%s\": {\"count\": %llu, \"mean_ns\": %.0f, "
+                  "\"p50_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu}%s\n",
+                  Name(static_cast<Metric>(i)),
+                  static_cast<unsigned long long>(h.Count()), h.Mean(),
+                  static_cast<unsigned long long>(h.Percentile(0.50)),
+                  static_cast<unsigned long long>(h.Percentile(0.99)),
+                  static_cast<unsigned long long>(h.Max()),
+                  i + 1 < METRIC_COUNT || !gaugeList.empty() ? "," : "");
+    out += line;
+  }
+
+  if (!gaugeList.empty()) {
+    out += "  \"gauges\": {" + gaugeList + "}\n";
+  }
+
+  out += "}\n";
+  return out;
+}
+
+bool Telemetry::WriteJson(char const* filename) const {
+  std::ofstream file(filename);
+  file << Json();
+  return static_cast<bool>(file);
+}
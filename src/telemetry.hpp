@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Host-side performance telemetry for the front end: how long emulation and
+// presenting take, how evenly frames come out, and how long key presses
+// wait before the keypad sees them.
+//
+// Each sample costs one bucket increment in a fixed-size histogram; there is
+// no allocation and no locking (everything is recorded on the main thread).
+
+// Log-linear histogram of durations in nanoseconds: 8 buckets per power of
+// two, so percentiles are accurate to about 6%, over the whole uint64 range.
+class Histogram {
+ public:
+  void Record(uint64_t ns);
+  void Reset();
+
+  uint64_t Count() const;
+  uint64_t Max() const;
+  double Mean() const;
+
+  // Smallest value such that a fraction "p" (0 to 1) of the samples are at
+  // or below it, to bucket resolution.
+  uint64_t Percentile(double p) const;
+
+ private:
+  static const unsigned int SUB_BUCKETS = 8;
+  static const unsigned int BUCKETS = (64 - 2) * SUB_BUCKETS;
+
+  static unsigned int BucketOf(uint64_t ns);
+  static uint64_t BucketMidpoint(unsigned int bucket);
+
+  uint32_t buckets[BUCKETS]{};
+  uint64_t count{};
+  uint64_t max{};
+  double sum{};
+};
+
+enum class Metric : uint8_t {
+  EMULATION,         // Running the CPU between two presented frames.
+  UPDATE,            // Platform::Update (upload, draw, present).
+  PRESENT_INTERVAL,  // Present to present.
+  JITTER,            // Change in present interval from one frame to the next.
+  INPUT_LATENCY,     // Key event timestamp to keypad update (ms resolution).
+  HOST_FRAME,        // Host time per emulated 60 Hz frame (governed runs).
+  COUNT
+};
+
+// Latest values of settings the front end adapts at run time.
+enum class Gauge : uint8_t {
+  CYCLES_PER_FRAME,  // Governor: instructions per 60 Hz frame.
+  PRESENT_INTERVAL,  // Governor: emulated frames per presented frame.
+  CPU_LOAD,          // Governor: host time used, fraction of one core.
+  COUNT
+};
+
+class Telemetry {
+ public:
+  void Record(Metric metric, uint64_t ns);
+
+  // Since startup.
+  Histogram const& Total(Metric metric) const;
+
+  // Since the last ResetRecent(), for a live display.
+  Histogram const& Recent(Metric metric) const;
+  void ResetRecent();
+
+  void SetGauge(Gauge gauge, double value);
+
+  // Every metric as count, mean, p50, p99 and max, in nanoseconds, then the
+  // gauges that have been set.
+  std::string Json() const;
+  bool WriteJson(char const* filename) const;
+
+  static char const* Name(Metric metric);
+  static char const* Name(Gauge gauge);
+
+ private:
+  static const unsigned int METRIC_COUNT =
+      static_cast<unsigned int>(Metric::COUNT);
+
+  Histogram total[METRIC_COUNT];
+  Histogram recent[METRIC_COUNT];
+
+  static const unsigned int GAUGE_COUNT =
+      static_cast<unsigned int>(Gauge::COUNT);
+
+  double gauges[GAUGE_COUNT]{};
+  bool gaugeSet[GAUGE_COUNT]{};
+};
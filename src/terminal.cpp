@@ -0,0 +1,211 @@
+#include "terminal.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#define TERMINAL_POSIX 1
+
+static termios savedMode;
+#endif
+
+// CHIP-8 key k is typed as KEYMAP[k].
+static char const KEYMAP[KEY_COUNT + 1] = "x123qweasdzc4rfv";
+
+// Indexed by cell state: nothing, top pixel, bottom pixel, both.
+static char const* const GLYPHS[4] = {" ", "▀", "▄", "█"};
+
+const auto REFRESH_INTERVAL = std::chrono::microseconds(1000000 / 60);
+
+Terminal::Terminal() {
+  std::memset(shown, 0xFF, sizeof(shown));
+
+#ifdef TERMINAL_POSIX
+  if (tcgetattr(STDIN_FILENO, &savedMode) == 0) {
+    termios raw = savedMode;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    raw.c_iflag &= ~(IXON | ICRNL);
+    // Reads return at once, with whatever has been typed.
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    rawMode = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+  }
+#endif
+
+  std::fputs("\x1b[?25l\x1b[2J", stdout);
+  std::fflush(stdout);
+}
+
+Terminal::~Terminal() {
+  std::printf("\x1b[0m\x1b[?25h\x1b[%u;1H\n", ROWS + 2);
+  std::fflush(stdout);
+
+#ifdef TERMINAL_POSIX
+  if (rawMode) {
+    tcsetattr(STDIN_FILENO, TCSANOW, &savedMode);
+  }
+#endif
+}
+
+bool Terminal::Writable() const {
+#ifdef TERMINAL_POSIX
+  pollfd fd{STDOUT_FILENO, POLLOUT, 0};
+  int ready = poll(&fd, 1, 0);
+  if (ready < 0) {
+    // Interrupted: skip this refresh and ask again at the next. Any other
+    // error means stdout can't be polled at all, so write regardless and
+    // block as if there were no check.
+    return errno != EINTR;
+  }
+  return ready == 1 && (fd.revents & POLLOUT);
+#else
+  return true;
+#endif
+}
+
+void Terminal::Update(uint32_t const* video) {
+  Clock::time_point now = Clock::now();
+  if (now - lastRefresh < REFRESH_INTERVAL || !Writable()) {
+    return;
+  }
+  lastRefresh = now;
+
+  out.clear();
+  // Where the terminal's cursor is, so adjacent changes need no move.
+  unsigned int cursorRow = ~0u;
+  unsigned int cursorColumn = ~0u;
+
+  for (unsigned int row = 0; row < ROWS; row++) {
+    uint32_t const* top = video + 2 * row * PX_WIDTH;
+    uint32_t const* bottom = top + PX_WIDTH;
+
+    for (unsigned int column = 0; column < PX_WIDTH; column++) {
+      // Phosphor frames are shades of grey with the alpha byte always at
+      // 0xFF, so test a colour byte instead: anything past half is on.
+      uint8_t state = (((top[column] >> 8u) & 0xFFu) >= 0x80u) |
+                      ((((bottom[column] >> 8u) & 0xFFu) >= 0x80u) << 1u);
+
+      uint8_t& cell = shown[row * PX_WIDTH + column];
+      if (cell == state) {
+        continue;
+      }
+      cell = state;
+
+      if (row != cursorRow || column != cursorColumn) {
+        char move[16];
+        std::snprintf(move, sizeof(move), "\x1b[%u;%uH", row + 1, column + 1);
+        out += move;
+      }
+      out += GLYPHS[state];
+      cursorRow = row;
+      cursorColumn = column + 1;
+    }
+  }
+
+  if (statusChanged) {
+    char move[16];
+    std::snprintf(move, sizeof(move), "\x1b[%u;1H", ROWS + 1);
+    out += move;
+    out += status;
+    out += "\x1b[K";
+    statusChanged = false;
+  }
+
+  if (!out.empty()) {
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    std::fflush(stdout);
+  }
+}
+
+void Terminal::SetStatus(char const* status) {
+  this->status = status;
+  statusChanged = true;
+}
+
+bool Terminal::ProcessInput(uint8_t* keys) {
+  bool quit = false;
+  Clock::time_point now = Clock::now();
+
+#ifdef TERMINAL_POSIX
+  char input[64];
+  ssize_t count;
+  while (rawMode && (count = read(STDIN_FILENO, input, sizeof(input))) > 0) {
+    for (ssize_t i = 0; i < count; i++) {
+      char c = input[i];
+
+      if (escape.size() == 1 && c == '\x1b') {
+        // Esc pressed twice.
+        quit = true;
+        escape.clear();
+      } else if (!escape.empty()) {
+        escape += c;
+        // ESC [ and ESC O (CSI and SS3) run up to a final byte in @ to ~;
+        // anything else after ESC is a single Alt-modified key.
+        bool introducer = escape.size() == 2 && (c == '[' || c == 'O');
+        if (!introducer && (escape.size() == 2 || (c >= '@' && c <= '~') ||
+                            escape.size() >= 16)) {
+          HandleEscape(escape);
+          escape.clear();
+        }
+      } else if (c == '\x1b') {
+        escape = c;
+        escapeStart = now;
+      } else if (c == '\x03') {
+        quit = true;
+      } else if (c == '\x0c') {
+        std::memset(shown, 0xFF, sizeof(shown));
+        statusChanged = true;
+        std::fputs("\x1b[2J", stdout);
+      } else if (c == '\t') {
+        lastFastForward = now;
+      } else if (char const* key = std::strchr(KEYMAP, c | 0x20)) {
+        lastPress[key - KEYMAP] = now;
+      }
+    }
+  }
+
+  // Nothing followed: a lone ESC is the Esc key. A sequence cut short is
+  // dropped.
+  if (!escape.empty() &&
+      now - escapeStart >= std::chrono::milliseconds(ESCAPE_TIMEOUT_MS)) {
+    quit = quit || escape.size() == 1;
+    escape.clear();
+  }
+#endif
+
+  auto hold = std::chrono::milliseconds(KEY_HOLD_MS);
+  for (unsigned int key = 0; key < KEY_COUNT; key++) {
+    keys[key] = lastPress[key] != Clock::time_point{} &&
+                now - lastPress[key] < hold;
+  }
+  return quit;
+}
+
+// Left and Right (ESC [ D / ESC [ C, or ESC O D / ESC O C in application
+// mode) skip around in replays. Other sequences and Alt-keys are ignored.
+void Terminal::HandleEscape(std::string const& sequence) {
+  if (sequence.size() != 3 || (sequence[1] != '[' && sequence[1] != 'O')) {
+    return;
+  }
+  if (sequence[2] == 'C') {
+    seekSteps++;
+  } else if (sequence[2] == 'D') {
+    seekSteps--;
+  }
+}
+
+bool Terminal::FastForwardHeld() const {
+  return lastFastForward != Clock::time_point{} &&
+         Clock::now() - lastFastForward <
+             std::chrono::milliseconds(KEY_HOLD_MS);
+}
+
+int Terminal::TakeSeekSteps() {
+  int steps = seekSteps;
+  seekSteps = 0;
+  return steps;
+}
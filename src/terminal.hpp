@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "chip8.hpp"
+
+// Text front end for machines without a display, e.g. over SSH.
+//
+// The framebuffer is drawn with Unicode half blocks, two pixels per
+// character cell (64 x 16 cells), plus a status line below it. Each refresh
+// only sends the cells that changed since the last one that was actually
+// written, using cursor addressing, so a mostly static screen costs a few
+// bytes per frame. Refreshes are capped at 60 per second, and skipped while
+// the terminal isn't accepting output, so a slow link drops frames instead
+// of falling behind.
+//
+// Keys are read from stdin in raw mode with the same layout as the window
+// (1234/QWER/ASDF/ZXCV, Tab, Left/Right; Esc or Ctrl-C quits, Ctrl-L
+// redraws). Terminals only report presses, so a key counts as held until
+// KEY_HOLD_MS after its last press or auto-repeat. Escape sequences may
+// arrive split across reads over a slow link, so Esc only quits when
+// nothing follows it within ESCAPE_TIMEOUT_MS.
+class Terminal {
+ public:
+  static constexpr unsigned int KEY_HOLD_MS = 150;
+  static constexpr unsigned int ESCAPE_TIMEOUT_MS = 100;
+
+  // Switches stdin to raw mode, hides the cursor and clears the screen.
+  Terminal();
+
+  // Restores the terminal.
+  ~Terminal();
+
+  Terminal(Terminal const&) = delete;
+  Terminal& operator=(Terminal const&) = delete;
+
+  // Draw "video" (PX_WIDTH * PX_HEIGHT pixels, as Chip8::Video() or an
+  // untinted phosphor-blended copy), if a refresh is due.
+  void Update(uint32_t const* video);
+
+  // Text shown under the picture, redrawn with the next refresh.
+  void SetStatus(char const* status);
+
+  // Same contract as Platform: fills "keys", returns true to quit.
+  bool ProcessInput(uint8_t* keys);
+  bool FastForwardHeld() const;
+  int TakeSeekSteps();
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  static const unsigned int ROWS = PX_HEIGHT / 2;
+
+  bool Writable() const;
+
+  // What each cell showed after the last refresh: bit 0 = top pixel,
+  // bit 1 = bottom pixel. 0xFF = unknown, drawn on the next refresh.
+  uint8_t shown[PX_WIDTH * ROWS];
+  std::string status;
+  bool statusChanged{};
+  std::string out;
+  Clock::time_point lastRefresh{};
+
+  void HandleEscape(std::string const& sequence);
+
+  // An escape sequence read only in part so far, and when it began.
+  std::string escape;
+  Clock::time_point escapeStart{};
+
+  Clock::time_point lastPress[KEY_COUNT]{};
+  Clock::time_point lastFastForward{};
+  int seekSteps{};
+  bool rawMode{};
+};
@@ -0,0 +1,86 @@
+#include "wall.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include "platform.hpp"
+#include "scheduler.hpp"
+
+void WallGrid(unsigned int count, unsigned int& columns, unsigned int& rows) {
+  columns = static_cast<unsigned int>(std::ceil(std::sqrt(count)));
+  columns = columns == 0 ? 1 : columns;
+  rows = (count + columns - 1) / columns;
+  rows = rows == 0 ? 1 : rows;
+}
+
+void RunWall(Platform& platform,
+             std::vector<std::unique_ptr<Chip8>> const& machines,
+             unsigned int cyclesPerFrame, unsigned long maxFrames) {
+  using Clock = std::chrono::steady_clock;
+  const auto FRAME = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(1.0 / 60));
+
+  Scheduler scheduler;
+  for (auto const& chip8 : machines) {
+    scheduler.Spawn(*chip8, RunMachine(scheduler, *chip8, cyclesPerFrame));
+  }
+
+  uint8_t keys[KEY_COUNT]{};
+  uint8_t sentKeys[KEY_COUNT]{};
+
+  auto nextFrame = Clock::now();
+  auto lastReport = nextFrame;
+  Clock::duration uploadTime{};
+  unsigned long reportFrames = 0;
+
+  for (unsigned long frame = 0; maxFrames == 0 || frame < maxFrames;
+       frame++) {
+    if (platform.ProcessInput(keys)) {
+      break;
+    }
+
+    // Broadcast key changes; presses wake machines parked on Fx0A.
+    for (uint8_t key = 0; key < KEY_COUNT; key++) {
+      if (keys[key] != sentKeys[key]) {
+        sentKeys[key] = keys[key];
+        for (Scheduler::MachineId id = 0; id < machines.size(); id++) {
+          scheduler.SetKey(id, key, keys[key] != 0);
+        }
+      }
+    }
+
+    scheduler.RunFrame();
+
+    auto uploadStart = Clock::now();
+    for (unsigned int i = 0; i < machines.size(); i++) {
+      platform.UploadMono(i, *machines[i]);
+    }
+    platform.Present();
+    uploadTime += Clock::now() - uploadStart;
+    reportFrames++;
+
+    auto now = Clock::now();
+    if (now - lastReport >= std::chrono::milliseconds(500)) {
+      char status[128];
+      std::snprintf(
+          status, sizeof(status),
+          "CHIP-8 Wall - %zu machines, %zu waiting for keys, %.2f ms/present",
+          machines.size(), scheduler.WaitingForKeys(),
+          std::chrono::duration<double, std::milli>(uploadTime).count() /
+              reportFrames);
+      platform.SetTitle(status);
+      lastReport = now;
+      uploadTime = {};
+      reportFrames = 0;
+    }
+
+    nextFrame += FRAME;
+    if (nextFrame < now) {
+      // Fell behind; don't try to catch up.
+      nextFrame = now;
+    }
+    std::this_thread::sleep_until(nextFrame);
+  }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "chip8.hpp"
+
+class Platform;
+
+// Display wall: many machines in one window, for watching batch runs.
+//
+// Every machine gets a HIRES_WIDTH x HIRES_HEIGHT tile of one texture. The
+// machines run through the coroutine scheduler (see scheduler.hpp), so ones
+// waiting for a key or a timer cost nothing; after each 60 Hz frame every
+// tile is uploaded (only the rows that changed reach the texture, see
+// Platform::UploadMono) and the window is presented once.
+
+// Tiles for "count" machines: as square as possible, wider than tall.
+void WallGrid(unsigned int count, unsigned int& columns, unsigned int& rows);
+
+// Run "machines" at "cyclesPerFrame" instructions per frame in "platform",
+// whose texture must be WallGrid() tiles. Keys go to every machine. Returns
+// when the window is closed, or after "maxFrames" frames (0 = never).
+void RunWall(Platform& platform,
+             std::vector<std::unique_ptr<Chip8>> const& machines,
+             unsigned int cyclesPerFrame, unsigned long maxFrames);
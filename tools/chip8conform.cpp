@@ -0,0 +1,322 @@
+// chip8conform: check that every execution engine behaves exactly like the
+// reference interpreter.
+//
+// Usage: chip8conform [Options] <ROM>...
+//   --cycles <N>        Instructions per ROM (default 20000)
+//   --frame-cycles <C>  Instructions per compared frame (default 64); below
+//                       32 the batched and recompiled engines never step
+//                       whole blocks
+//   --threads <T>       Worker threads (default: every core)
+//   --golden <File>     Also compare against hashes stored in File
+//   --update            Write the reference hashes to the --golden file
+//
+// Each ROM runs for a fixed number of instructions on every engine, with the
+// same scripted key presses and random seed. After every frame a hash of the
+// framebuffer, V0-VF, I and pc is taken. Any engine whose hashes differ from
+// the interpreter's (or from the golden file) fails, and the first diverging
+// frame is reported. The exit status is non-zero on any failure, including
+// a ROM the --golden file has no hashes for at these settings.
+//
+// Engines:
+//   interpreter  Cycle() one instruction at a time (the reference)
+//   batched      RunCycles() per frame
+//   snapshot     Encode/Decode the whole machine into a fresh one every frame
+//   recompiled   Ahead-of-time translated blocks (builds configured with
+//                CHIP8_RECOMPILE_ROM, for that ROM only)
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+#include "recompiled.hpp"
+#include "snapshot.hpp"
+
+struct RunOptions {
+  unsigned long cycles = 20000;
+  // RunCycles() only steps recompiled blocks while a whole one fits in the
+  // budget, so frames shorter than RECOMPILED_MAX_BLOCK would leave the
+  // batched and recompiled engines running the reference's Cycle() loop.
+  unsigned int frameCycles = 2 * RECOMPILED_MAX_BLOCK;
+};
+
+struct Engine {
+  char const* name;
+
+  // Prepare "chip8" (ROM loaded, variant set). False = not applicable.
+  bool (*setup)(Chip8& chip8);
+
+  // Run one frame of "cycles" instructions. May replace the machine.
+  void (*runFrame)(std::unique_ptr<Chip8>& chip8, unsigned int cycles);
+};
+
+static bool NoSetup(Chip8&) { return true; }
+
+static void RunInterpreter(std::unique_ptr<Chip8>& chip8,
+                           unsigned int cycles) {
+  for (unsigned int i = 0; i < cycles; i++) {
+    chip8->Cycle();
+  }
+}
+
+static void RunBatched(std::unique_ptr<Chip8>& chip8, unsigned int cycles) {
+  chip8->RunCycles(cycles);
+}
+
+static void RunThroughSnapshot(std::unique_ptr<Chip8>& chip8,
+                               unsigned int cycles) {
+  std::string encoded;
+  Snapshot(*chip8).Encode(encoded);
+
+  Snapshot decoded;
+  auto fresh = std::make_unique<Chip8>();
+  fresh->SetVariant(chip8->GetVariant());
+  if (decoded.Decode(reinterpret_cast<uint8_t const*>(encoded.data()),
+                     encoded.size())) {
+    decoded.Restore(*fresh);
+  }
+  chip8 = std::move(fresh);
+
+  RunInterpreter(chip8, cycles);
+}
+
+#ifdef CHIP8_HAS_RECOMPILED
+static bool AttachRecompiled(Chip8& chip8) {
+  return chip8.AttachRecompiled(&RECOMPILED_ROM);
+}
+#endif
+
+static const Engine ENGINES[] = {
+    {"interpreter", NoSetup, RunInterpreter},
+    {"batched", NoSetup, RunBatched},
+    {"snapshot", NoSetup, RunThroughSnapshot},
+#ifdef CHIP8_HAS_RECOMPILED
+    {"recompiled", AttachRecompiled, RunBatched},
+#endif
+};
+static const unsigned int ENGINE_COUNT = sizeof(ENGINES) / sizeof(ENGINES[0]);
+
+// FNV-1a, 64-bit.
+static uint64_t Hash(uint64_t hash, void const* data, size_t size) {
+  auto const* bytes = static_cast<uint8_t const*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+  }
+  return hash;
+}
+
+static uint64_t MachineHash(Chip8 const& chip8) {
+  uint64_t hash = 0xCBF29CE484222325ull;
+  if (chip8.HiRes()) {
+    // Video() would fold 2x2 pixels together; compare every one of them.
+    hash = Hash(hash, chip8.DisplayRows(),
+                sizeof(uint64_t) * HIRES_HEIGHT * DISPLAY_WORDS);
+  } else {
+    // As before hi-res existed, so lo-res golden files stay valid.
+    hash = Hash(hash, chip8.Video(), sizeof(uint32_t) * PX_WIDTH * PX_HEIGHT);
+  }
+  hash = Hash(hash, chip8.Registers(), REGISTER_COUNT);
+  uint16_t pointers[2] = {chip8.Index(), chip8.Pc()};
+  return Hash(hash, pointers, sizeof(pointers));
+}
+
+// The same key presses for every engine: mostly idle, with one key held for
+// a while every so often, cycling through all 16.
+static void ScriptKeys(Chip8& chip8, unsigned long frame) {
+  bool held = (frame / 16) % 4 == 3;
+  uint8_t key = (frame / 64) % KEY_COUNT;
+  for (uint8_t k = 0; k < KEY_COUNT; k++) {
+    chip8.SetKey(k, held && k == key);
+  }
+}
+
+// Per-frame hashes, or empty if the engine doesn't apply to this ROM.
+static std::vector<uint64_t> Run(char const* romFilename, Engine const& engine,
+                                 RunOptions const& options) {
+  auto chip8 = std::make_unique<Chip8>();
+  chip8->LoadROM(romFilename);
+  chip8->SetVariant(VariantFromFilename(romFilename));
+  chip8->Seed(0);
+  if (!engine.setup(*chip8)) {
+    return {};
+  }
+
+  std::vector<uint64_t> hashes;
+  unsigned long frames = options.cycles / options.frameCycles;
+  for (unsigned long frame = 0; frame < frames; frame++) {
+    ScriptKeys(*chip8, frame);
+    engine.runFrame(chip8, options.frameCycles);
+    hashes.push_back(MachineHash(*chip8));
+  }
+  return hashes;
+}
+
+static std::string BaseName(std::string const& path) {
+  size_t slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Index of the first differing frame, or -1.
+static long FirstDifference(std::vector<uint64_t> const& a,
+                            std::vector<uint64_t> const& b) {
+  for (size_t i = 0; i < std::max(a.size(), b.size()); i++) {
+    if (i >= a.size() || i >= b.size() || a[i] != b[i]) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int main(int argc, char** argv) {
+  RunOptions options;
+  unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+  char const* goldenFilename = nullptr;
+  bool update = false;
+  std::vector<char const*> roms;
+
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+
+    if (std::strcmp(argv[i], "--cycles") == 0 && hasValue) {
+      options.cycles = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--frame-cycles") == 0 && hasValue) {
+      options.frameCycles = std::max(1ul, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+      threadCount = std::max(1ul, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--golden") == 0 && hasValue) {
+      goldenFilename = argv[++i];
+    } else if (std::strcmp(argv[i], "--update") == 0) {
+      update = true;
+    } else if (argv[i][0] == '-') {
+      std::cerr << "Unknown option: " << argv[i] << "\n";
+      return EXIT_FAILURE;
+    } else {
+      roms.push_back(argv[i]);
+    }
+  }
+
+  if (roms.empty() || (update && !goldenFilename)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--cycles N] [--frame-cycles C] [--threads T]"
+                 " [--golden File [--update]] <ROM>...\n";
+    return EXIT_FAILURE;
+  }
+
+  // Every (ROM, engine) pair is one job.
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::vector<uint64_t>> results(roms.size() * ENGINE_COUNT);
+  std::atomic<unsigned int> nextJob{0};
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < threadCount; t++) {
+    threads.emplace_back([&] {
+      for (unsigned int job = nextJob++; job < results.size();
+           job = nextJob++) {
+        results[job] = Run(roms[job / ENGINE_COUNT],
+                           ENGINES[job % ENGINE_COUNT], options);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  double elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  // Goldens: one line per ROM, "name cycles frameCycles hash...".
+  std::map<std::string, std::vector<uint64_t>> goldens;
+  if (goldenFilename && !update) {
+    std::ifstream file(goldenFilename);
+    if (!file) {
+      std::cerr << "Can't read " << goldenFilename << "\n";
+      return EXIT_FAILURE;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+      std::istringstream words(line);
+      std::string name;
+      unsigned long cycles, frameCycles;
+      if (line.empty() || line[0] == '#' ||
+          !(words >> name >> cycles >> frameCycles) ||
+          cycles != options.cycles || frameCycles != options.frameCycles) {
+        continue;
+      }
+      std::vector<uint64_t>& hashes = goldens[name];
+      for (std::string hash; words >> hash;) {
+        hashes.push_back(std::stoull(hash, nullptr, 16));
+      }
+    }
+  }
+
+  bool failed = false;
+  std::ostringstream goldenOut;
+  goldenOut << "# chip8conform: ROM, cycles, cycles per frame, frame hashes\n";
+
+  for (size_t r = 0; r < roms.size(); r++) {
+    std::string name = BaseName(roms[r]);
+    std::vector<uint64_t> const& reference = results[r * ENGINE_COUNT];
+
+    auto golden = goldens.find(name);
+    if (golden != goldens.end()) {
+      long frame = FirstDifference(reference, golden->second);
+      std::printf("%-24s %-12s %s", name.c_str(), "golden",
+                  frame < 0 ? "ok\n" : "DIVERGES");
+      if (frame >= 0) {
+        std::printf(" at frame %ld (cycle %lu)\n", frame,
+                    frame * options.frameCycles);
+        failed = true;
+      }
+    } else if (goldenFilename && !update) {
+      // A ROM the goldens don't cover would otherwise pass unchecked.
+      std::printf("%-24s %-12s MISSING for these settings\n", name.c_str(),
+                  "golden");
+      failed = true;
+    }
+
+    for (unsigned int e = 1; e < ENGINE_COUNT; e++) {
+      std::vector<uint64_t> const& hashes = results[r * ENGINE_COUNT + e];
+      if (hashes.empty()) {
+        std::printf("%-24s %-12s skipped\n", name.c_str(), ENGINES[e].name);
+        continue;
+      }
+
+      long frame = FirstDifference(reference, hashes);
+      std::printf("%-24s %-12s %s", name.c_str(), ENGINES[e].name,
+                  frame < 0 ? "ok\n" : "DIVERGES");
+      if (frame >= 0) {
+        std::printf(" at frame %ld (cycle %lu)\n", frame,
+                    frame * options.frameCycles);
+        failed = true;
+      }
+    }
+
+    goldenOut << name << " " << options.cycles << " " << options.frameCycles;
+    for (uint64_t hash : reference) {
+      char text[20];
+      std::snprintf(text, sizeof(text), " %016llx",
+                    static_cast<unsigned long long>(hash));
+      goldenOut << text;
+    }
+    goldenOut << "\n";
+  }
+
+  if (update) {
+    std::ofstream file(goldenFilename);
+    file << goldenOut.str();
+    std::printf("Wrote %s\n", goldenFilename);
+  }
+
+  std::printf("%zu ROMs x %u engines in %.2f s: %s\n", roms.size(),
+              ENGINE_COUNT, elapsed, failed ? "FAILED" : "passed");
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+// chip8envd: host many CHIP-8 environments for RL clients in other
+// processes, over shared memory (see src/envserver.hpp for the layout).
+//
+// Usage:
+//   chip8envd <ROM> <Envs> [Options]   Serve until a client shuts it down.
+//   chip8envd <ROM> --bench [Options]  Measure steps/s for several
+//                                      environment and thread counts.
+// Options:
+//   --name <Name>      Shared-memory object name (default /chip8env)
+//   --threads <T>      Worker threads (default: every core)
+//   --cycles <C>       Instructions per step (default 100)
+//   --probe <Address>  Report memory[Address] each step (repeatable)
+//   --variant <Name>   chip8, schip or xochip quirks
+//   --seconds <S>      Duration of each benchmark point (default 1)
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "envserver.hpp"
+
+static void Bench(char const* romFilename, Variant variant,
+                  std::string const& name, unsigned int maxThreads,
+                  unsigned int cycles, double seconds) {
+  std::cout << "envs threads   steps/s  env-steps/s\n";
+
+  for (unsigned int envCount : {1u, 4u, 16u, 64u, 256u}) {
+    for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+      if (threads > envCount) {
+        break;
+      }
+
+      EnvServer server(romFilename, variant, name, envCount, threads, cycles,
+                       {});
+      EnvClient client(name);
+      if (!server.Ok() || !client.Ok()) {
+        std::cerr << "Can't set up shared memory " << name << "\n";
+        return;
+      }
+
+      // Press a different key per environment so they don't all idle.
+      for (unsigned int i = 0; i < envCount; i++) {
+        client.Slot(i).keys = 1u << (i % KEY_COUNT);
+      }
+
+      auto start = std::chrono::steady_clock::now();
+      double elapsed = 0;
+      unsigned long steps = 0;
+      while (elapsed < seconds) {
+        client.Step();
+        steps++;
+        elapsed = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      }
+
+      double rate = steps / elapsed;
+      std::printf("%4u %7u %9.0f %12.0f\n", envCount, threads, rate,
+                  rate * envCount);
+      std::fflush(stdout);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0] << " <ROM> <Envs> [Options]\n"
+              << "       " << argv[0] << " <ROM> --bench [Options]\n";
+    return EXIT_FAILURE;
+  }
+
+  char const* romFilename = argv[1];
+  bool bench = std::strcmp(argv[2], "--bench") == 0;
+  unsigned int envCount = bench ? 0 : std::stoul(argv[2]);
+
+  std::string name = "/chip8env";
+  unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+  unsigned int cycles = 100;
+  double seconds = 1.0;
+  std::vector<uint16_t> probes;
+  Variant variant = VariantFromFilename(romFilename);
+
+  for (int i = 3; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+
+    if (std::strcmp(argv[i], "--name") == 0 && hasValue) {
+      name = argv[++i];
+    } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+      threads = std::max(1ul, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--cycles") == 0 && hasValue) {
+      cycles = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--probe") == 0 && hasValue) {
+      probes.push_back(std::stoul(argv[++i], nullptr, 0));
+    } else if (std::strcmp(argv[i], "--seconds") == 0 && hasValue) {
+      seconds = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--variant") == 0 && hasValue) {
+      if (!ParseVariant(argv[++i], variant)) {
+        std::cerr << "Unknown variant: " << argv[i] << "\n";
+        return EXIT_FAILURE;
+      }
+    } else {
+      std::cerr << "Unknown option: " << argv[i] << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (bench) {
+    Bench(romFilename, variant, name, threads, cycles, seconds);
+    return EXIT_SUCCESS;
+  }
+
+  EnvServer server(romFilename, variant, name, envCount, threads, cycles,
+                   probes);
+  if (!server.Ok()) {
+    std::cerr << "Can't set up shared memory " << name << "\n";
+    return EXIT_FAILURE;
+  }
+
+  std::cerr << "Serving " << envCount << " environments on " << name << "\n";
+  auto start = std::chrono::steady_clock::now();
+  server.Wait();
+
+  double elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  std::cerr << server.StepsServed() << " steps in " << elapsed << " s ("
+            << server.StepsServed() * envCount / elapsed
+            << " env-steps/s)\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,221 @@
+// chip8fuzz: coverage-guided fuzzing of keypad input, to find inputs that
+// make a ROM fault or lock up.
+//
+// Usage: chip8fuzz <ROM> [Options]
+//   --time <Seconds>        How long to fuzz (default 60)
+//   --execs <N>             Stop after about N executions instead
+//   --frames <N>            Longest input, in frames (default 30)
+//   --cycles-per-frame <C>  Instructions per frame (default 10)
+//   --stall <F>             Frames without progress, with keys pressed,
+//                           before checking for a soft-lock (default 20,
+//                           0 = don't look for them)
+//   --keys <Digits>         Keys inputs may press, as hex digits
+//                           (default 0-F)
+//   --threads <T>           Worker threads (default: every core)
+//   --seed <S>              Random seed, for the machine and the mutations
+//                           (default 1)
+//   --variant <Name>        chip8, schip or xochip quirks
+//   --out <Directory>       Write each finding as a .c8r replay, to watch
+//                           with chip8emu --faults halt
+//
+// Prints progress once a second, then one line per finding, and exits
+// with failure if there were any.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fuzz.hpp"
+#include "library.hpp"
+#include "replay.hpp"
+
+// Replay "finding" from "root" one cycle per frame, the way chip8emu
+// records, up to the instruction that faulted or the point it got stuck.
+static bool WriteReplay(std::string const& path, Chip8 const& root,
+                        FuzzOptions const& options,
+                        FuzzFinding const& finding) {
+  Chip8 chip8 = root;
+  chip8.SetFaultPolicy(FaultPolicy::HALT);
+
+  ReplayWriter writer(path.c_str(), chip8.GetVariant(), 1, 1000);
+  if (!writer.Ok()) {
+    return false;
+  }
+
+  for (uint16_t keys : finding.input) {
+    for (uint8_t key = 0; key < KEY_COUNT; key++) {
+      chip8.SetKey(key, (keys >> key) & 1u);
+    }
+    for (unsigned int i = 0; i < options.cyclesPerFrame && !chip8.Halted();
+         i++) {
+      writer.BeginFrame(chip8);
+      chip8.Cycle();
+    }
+  }
+  writer.Finish();
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <ROM> [Options]\n"
+              << "  --time <Seconds>        How long to fuzz (default 60)\n"
+              << "  --execs <N>             Stop after about N executions\n"
+              << "  --frames <N>            Longest input (default 30)\n"
+              << "  --cycles-per-frame <C>  Instructions per frame (default 10)\n"
+              << "  --stall <F>             Frames before a soft-lock check\n"
+              << "  --keys <Digits>         Keys to press (default 0-F)\n"
+              << "  --threads <T>           Worker threads\n"
+              << "  --seed <S>              Random seed (default 1)\n"
+              << "  --variant <Name>        chip8, schip or xochip\n"
+              << "  --out <Directory>       Write findings as .c8r replays\n";
+    return EXIT_FAILURE;
+  }
+
+  char const* romFilename = argv[1];
+  FuzzOptions options;
+  options.threads = std::max(1u, std::thread::hardware_concurrency());
+  double seconds = 60.0;
+  unsigned long long maxExecutions = 0;
+  std::string keys = "0123456789ABCDEF";
+  Variant variant = VariantFromFilename(romFilename);
+  char const* outDirectory = nullptr;
+
+  for (int i = 2; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+
+    if (std::strcmp(argv[i], "--time") == 0 && hasValue) {
+      seconds = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--execs") == 0 && hasValue) {
+      maxExecutions = std::stoull(argv[++i]);
+    } else if (std::strcmp(argv[i], "--frames") == 0 && hasValue) {
+      options.maxFrames = std::max(1ul, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--cycles-per-frame") == 0 && hasValue) {
+      options.cyclesPerFrame = std::max(1ul, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--stall") == 0 && hasValue) {
+      options.stallFrames = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--keys") == 0 && hasValue) {
+      keys = argv[++i];
+    } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+      options.threads = std::max(1ul, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) {
+      options.seed = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--variant") == 0 && hasValue) {
+      if (!ParseVariant(argv[++i], variant)) {
+        std::cerr << "Unknown variant: " << argv[i] << "\n";
+        return EXIT_FAILURE;
+      }
+    } else if (std::strcmp(argv[i], "--out") == 0 && hasValue) {
+      outDirectory = argv[++i];
+    } else {
+      std::cerr << "Unknown option: " << argv[i] << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  options.keys = 0;
+  for (char digit : keys) {
+    char text[2] = {digit, '\0'};
+    char* end;
+    unsigned long key = std::strtoul(text, &end, 16);
+    if (*end != '\0') {
+      std::cerr << "Bad key: " << digit << "\n";
+      return EXIT_FAILURE;
+    }
+    options.keys |= static_cast<uint16_t>(1u << key);
+  }
+
+  Chip8 root;
+  root.LoadROM(romFilename);
+  root.SetVariant(variant);
+  root.Seed(options.seed);
+
+  Fuzzer fuzzer(root, options);
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = [&start] {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start)
+        .count();
+  };
+
+  fuzzer.Start();
+  double nextReport = 1.0;
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    double now = elapsed();
+    FuzzStats stats = fuzzer.Stats();
+    bool done = now >= seconds ||
+                (maxExecutions > 0 && stats.executions >= maxExecutions);
+
+    if (now >= nextReport || done) {
+      std::printf(
+          "%6.1f s  %llu execs (%.0f/s)  corpus %zu  %u addresses  %u edges"
+          "  %zu crashes  %zu soft-locks\n",
+          now, static_cast<unsigned long long>(stats.executions),
+          stats.executions / now, stats.corpusSize, stats.pcs, stats.edges,
+          stats.crashes, stats.softLocks);
+      std::fflush(stdout);
+      nextReport = now + 1.0;
+    }
+    if (done) {
+      break;
+    }
+  }
+  fuzzer.Stop();
+
+  FuzzStats stats = fuzzer.Stats();
+  double total = elapsed();
+  std::printf("%llu executions, %llu instructions in %.2f s (%u threads)\n",
+              static_cast<unsigned long long>(stats.executions),
+              static_cast<unsigned long long>(stats.cycles), total,
+              options.threads);
+
+  std::vector<FuzzFinding> findings = fuzzer.Findings();
+  if (outDirectory) {
+    std::filesystem::create_directories(outDirectory);
+  }
+
+  for (size_t i = 0; i < findings.size(); i++) {
+    FuzzFinding const& finding = findings[i];
+    bool crash = finding.kind == FuzzFinding::Kind::CRASH;
+
+    std::printf("%s at %03X (%04X) after %llu instructions, %zu frames:",
+                crash ? FaultName(finding.fault) : "soft-lock", finding.pc,
+                finding.opcode, static_cast<unsigned long long>(finding.cycle),
+                finding.input.size());
+    for (uint16_t frameKeys : finding.input) {
+      if (frameKeys == 0) {
+        std::printf(" -");
+        continue;
+      }
+      std::printf(" ");
+      for (unsigned int key = 0; key < KEY_COUNT; key++) {
+        if (frameKeys & (1u << key)) {
+          std::printf("%X", key);
+        }
+      }
+    }
+    std::printf("\n");
+
+    if (outDirectory) {
+      char name[64];
+      std::snprintf(name, sizeof(name), "%02zu-%s-%03X.c8r", i,
+                    crash ? "crash" : "softlock", finding.pc);
+      std::string path =
+          (std::filesystem::path(outDirectory) / name).string();
+      if (!WriteReplay(path, root, options, finding)) {
+        std::cerr << "Can't write " << path << "\n";
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  return findings.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,72 @@
+// chip8lib: build and inspect ROM library indexes (see src/library.hpp).
+//
+// Usage: chip8lib <Directory> <Index.c8l>   Index every ROM under Directory
+//        chip8lib --list <Index.c8l>        Print what an index holds
+//
+// chip8emu --library <Index.c8l> then starts ROMs by name or hash.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "library.hpp"
+
+static char const* VariantName(Variant variant) {
+  switch (variant) {
+    case Variant::SCHIP:
+      return "schip";
+    case Variant::XOCHIP:
+      return "xochip";
+    default:
+      return "chip8";
+  }
+}
+
+static int List(char const* indexFilename) {
+  RomLibrary library(indexFilename);
+  if (!library.Ok()) {
+    std::cerr << "Not a valid ROM library: " << indexFilename << "\n";
+    return EXIT_FAILURE;
+  }
+
+  std::printf("%-16s %5s %-7s %5s %6s %9s  %-5s %s\n", "Hash", "Size",
+              "Variant", "IPS", "Blocks", "Reachable", "Flags", "Name");
+  for (size_t i = 0; i < library.Count(); i++) {
+    RomInfo rom = library.Entry(i);
+    char flags[5] = {
+        rom.flags & LIBRARY_VARIANT_FROM_CODE ? 'v' : '-',
+        rom.flags & LIBRARY_INDIRECT_JUMPS ? 'b' : '-',
+        rom.flags & LIBRARY_WAITS_FOR_KEYS ? 'k' : '-',
+        rom.flags & LIBRARY_SELF_MODIFYING ? 's' : '-', '\0'};
+    std::printf("%016llx %5u %-7s %5u %6u %8u%%  %-5s %.*s\n",
+                static_cast<unsigned long long>(rom.hash), rom.size,
+                VariantName(rom.variant), rom.instructionsPerSecond,
+                rom.blockCount, rom.reachableBytes * 100 / rom.size, flags,
+                static_cast<int>(rom.name.size()), rom.name.data());
+  }
+  std::printf("Flags: v = variant detected from code, b = Bnnn, "
+              "k = waits for keys, s = self-modifying\n");
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+  if (argc == 3 && std::strcmp(argv[1], "--list") == 0) {
+    return List(argv[2]);
+  }
+
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <Directory> <Index.c8l>\n"
+              << "       " << argv[0] << " --list <Index.c8l>\n";
+    return EXIT_FAILURE;
+  }
+
+  long count = RomLibrary::Build(argv[1], argv[2], std::cerr);
+  if (count < 0) {
+    std::cerr << "Can't write " << argv[2] << "\n";
+    return EXIT_FAILURE;
+  }
+  std::printf("Indexed %ld ROMs into %s\n", count, argv[2]);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,285 @@
+// chip8recomp: translate a CHIP-8 ROM ahead of time into C++.
+//
+// Usage: chip8recomp <ROM> <Output.cpp> [--variant chip8|schip|xochip]
+//
+// The ROM is split into basic blocks by following every statically known
+// path from 0x200 (jumps, calls, returns and skips). Each block becomes one
+// C++ function over the same machine state as Chip8, see src/recompiled.hpp.
+// Simple register instructions are translated to plain C++, everything else
+// is handed to the interpreter. Code reached only through Bnnn, or rewritten
+// by the program at run time, stays with the interpreter.
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "cfg.hpp"
+#include "quirks.hpp"
+#include "recompiled.hpp"
+
+const uint16_t START_ADDRESS = 0x200;
+
+static std::string Format(char const* format, ...) {
+  va_list args;
+  va_start(args, format);
+  va_list sizeArgs;
+  va_copy(sizeArgs, args);
+  int size = std::vsnprintf(nullptr, 0, format, sizeArgs);
+  va_end(sizeArgs);
+
+  std::string out(size, '\0');
+  std::vsnprintf(out.data(), size + 1, format, args);
+  va_end(args);
+  return out;
+}
+
+static char const* VariantName(Variant variant) {
+  switch (variant) {
+    case Variant::SCHIP:
+      return "SCHIP";
+    case Variant::XOCHIP:
+      return "XOCHIP";
+    default:
+      return "CHIP8";
+  }
+}
+
+// Translate one instruction that doesn't end the block into C++.
+// Returns an empty string if it has to go through the interpreter.
+static std::string TranslateNative(uint16_t opcode) {
+  unsigned int x = (opcode & 0x0F00u) >> 8u;
+  unsigned int y = (opcode & 0x00F0u) >> 4u;
+  unsigned int kk = opcode & 0x00FFu;
+  unsigned int nnn = opcode & 0x0FFFu;
+
+  switch ((opcode & 0xF000u) >> 12u) {
+    case 0x6:
+      return Format("  V[0x%X] = 0x%02X;\n", x, kk);
+    case 0x7:
+      return Format("  V[0x%X] += 0x%02X;\n", x, kk);
+    case 0xA:
+      return Format("  I = 0x%03X;\n", nnn);
+    case 0x8:
+      // Same statements, in the same order, as the interpreter, so the
+      // results match even when x or y is F.
+      switch (opcode & 0x000Fu) {
+        case 0x0:
+          return Format("  V[0x%X] = V[0x%X];\n", x, y);
+        case 0x1:
+          return Format("  V[0x%X] |= V[0x%X];\n", x, y);
+        case 0x2:
+          return Format("  V[0x%X] &= V[0x%X];\n", x, y);
+        case 0x3:
+          return Format("  V[0x%X] ^= V[0x%X];\n", x, y);
+        case 0x4:
+          return Format(
+              "  {\n"
+              "    uint16_t sum = V[0x%X] + V[0x%X];\n"
+              "    V[0xF] = (sum > 255U) ? 1 : 0;\n"
+              "    V[0x%X] = sum & 0x00FFu;\n"
+              "  }\n",
+              x, y, x);
+        case 0x5:
+          return Format(
+              "  V[0xF] = (V[0x%X] < V[0x%X]) ? 0 : 1;\n"
+              "  V[0x%X] -= V[0x%X];\n",
+              x, y, x, y);
+        case 0x7:
+          return Format(
+              "  V[0xF] = (V[0x%X] > V[0x%X]) ? 1 : 0;\n"
+              "  V[0x%X] = V[0x%X] - V[0x%X];\n",
+              y, x, x, y, x);
+      }
+      break;
+  }
+
+  return "";
+}
+
+// The condition under which a skip instruction skips, or empty if the skip
+// is left to the interpreter.
+static std::string SkipCondition(uint16_t opcode) {
+  unsigned int x = (opcode & 0x0F00u) >> 8u;
+  unsigned int y = (opcode & 0x00F0u) >> 4u;
+  unsigned int kk = opcode & 0x00FFu;
+
+  switch ((opcode & 0xF000u) >> 12u) {
+    case 0x3:
+      return Format("V[0x%X] == 0x%02X", x, kk);
+    case 0x4:
+      return Format("V[0x%X] != 0x%02X", x, kk);
+    case 0x9:
+      return Format("V[0x%X] != V[0x%X]", x, y);
+  }
+
+  return "";
+}
+
+static bool ReadsOrWritesTimers(uint16_t opcode) {
+  uint8_t low = opcode & 0x00FFu;
+  return (opcode & 0xF000u) == 0xF000u &&
+         (low == 0x07 || low == 0x15 || low == 0x18);
+}
+
+static bool WritesMemory(uint16_t opcode) {
+  uint8_t low = opcode & 0x00FFu;
+  return (opcode & 0xF000u) == 0xF000u && (low == 0x33 || low == 0x55);
+}
+
+static std::string TranslateBlock(BasicBlock const& block,
+                                  std::vector<uint8_t> const& rom) {
+  std::string out;
+  out += Format("// 0x%03X - 0x%03X\n", block.start, block.end);
+  out += Format("static unsigned int Block_%03X(Chip8 &c) {\n", block.start);
+  out += "  [[maybe_unused]] uint8_t *V = Chip8Access::Registers(c);\n";
+  out += "  [[maybe_unused]] uint16_t &I = Chip8Access::Index(c);\n";
+  out += "  [[maybe_unused]] uint16_t &pc = Chip8Access::Pc(c);\n";
+
+  // Timers tick once per instruction. Instead of ticking after every
+  // instruction, catch up in one go before anything that can observe them,
+  // and at the end of the block.
+  unsigned int count = 0;
+  unsigned int ticked = 0;
+  auto tick = [&](unsigned int upTo) {
+    std::string s;
+    if (upTo > ticked) {
+      s = Format("  Chip8Access::Tick(c, %u);\n", upTo - ticked);
+      ticked = upTo;
+    }
+    return s;
+  };
+
+  for (uint16_t address = block.start; address < block.end; address += 2) {
+    uint16_t opcode = (rom[address - START_ADDRESS] << 8u) |
+                      rom[address - START_ADDRESS + 1];
+    bool last = address + 2 == block.end;
+    count++;
+
+    out += Format("  // 0x%03X: %04X\n", address, opcode);
+
+    if (last && block.exit == Flow::JUMP) {
+      out += tick(count);
+      out += Format("  pc = 0x%03X;\n", opcode & 0x0FFFu);
+      out += Format("  return %u;\n", count);
+      break;
+    }
+
+    std::string condition =
+        (last && block.exit == Flow::SKIP) ? SkipCondition(opcode) : "";
+    if (!condition.empty()) {
+      out += tick(count);
+      out += Format("  pc = (%s) ? 0x%03X : 0x%03X;\n", condition.c_str(),
+                    address + 4, address + 2);
+      out += Format("  return %u;\n", count);
+      break;
+    }
+
+    std::string native = TranslateNative(opcode);
+    if (!native.empty()) {
+      out += native;
+    } else {
+      if (ReadsOrWritesTimers(opcode)) {
+        out += tick(count - 1);
+      }
+      out += Format("  Chip8Access::Execute(c, 0x%03X, 0x%04X);\n", address,
+                    opcode);
+
+      // A fault that halts the machine leaves pc on the instruction; don't
+      // run on past it or move pc.
+      out += "  if (Chip8Access::Halted(c)) {\n";
+      out += Format("    return %u;\n", count - 1);
+      out += "  }\n";
+
+      if (WritesMemory(opcode)) {
+        // If that store hit translated code, stop here and let Step() fall
+        // back to the interpreter. The ticks only happen on that path.
+        unsigned int tickedBefore = ticked;
+        out += "  if (!Chip8Access::CodeIntact(c)) {\n";
+        out += "  " + tick(count);
+        out += Format("    return %u;\n", count);
+        out += "  }\n";
+        ticked = tickedBefore;
+      }
+    }
+
+    if (last) {
+      // Either the block was cut for length, it runs off the end of the ROM,
+      // or the interpreter just ran the control-flow instruction and left pc
+      // where it belongs.
+      out += tick(count);
+      if (block.exit == Flow::NEXT) {
+        out += Format("  pc = 0x%03X;\n", block.end);
+      }
+      out += Format("  return %u;\n", count);
+    }
+  }
+
+  out += "}\n\n";
+  return out;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <ROM> <Output.cpp> [--variant chip8|schip|xochip]\n";
+    return EXIT_FAILURE;
+  }
+
+  Variant variant = VariantFromFilename(argv[1]);
+  if (argc >= 5 && std::strcmp(argv[3], "--variant") == 0 &&
+      !ParseVariant(argv[4], variant)) {
+    std::cerr << "Unknown variant: " << argv[4] << "\n";
+    return EXIT_FAILURE;
+  }
+
+  std::ifstream file(argv[1], std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Can't open " << argv[1] << "\n";
+    return EXIT_FAILURE;
+  }
+  std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+
+  std::vector<BasicBlock> blocks =
+      BuildCfg(rom.data(), rom.size(), START_ADDRESS, START_ADDRESS,
+               RECOMPILED_MAX_BLOCK);
+
+  std::string out;
+  out += Format("// Generated by chip8recomp from %s. Do not edit.\n", argv[1]);
+  out += "#include \"recompiled.hpp\"\n\n";
+
+  for (BasicBlock const& block : blocks) {
+    out += TranslateBlock(block, rom);
+  }
+
+  out += "static const uint8_t ROM_IMAGE[] = {";
+  for (size_t i = 0; i < rom.size(); i++) {
+    out += Format("%s0x%02X,", (i % 12 == 0) ? "\n    " : " ", rom[i]);
+  }
+  out += "\n};\n\n";
+
+  out += "static const RecompiledBlock BLOCKS[] = {\n";
+  for (BasicBlock const& block : blocks) {
+    out += Format("    {0x%03X, 0x%03X, &Block_%03X},\n", block.start,
+                  block.end, block.start);
+  }
+  out += "};\n\n";
+
+  out += Format(
+      "extern const RecompiledRom RECOMPILED_ROM = {\n"
+      "    ROM_IMAGE, sizeof(ROM_IMAGE), Variant::%s,\n"
+      "    BLOCKS, sizeof(BLOCKS) / sizeof(BLOCKS[0])};\n",
+      VariantName(variant));
+
+  std::ofstream output(argv[2]);
+  output << out;
+
+  std::cerr << "chip8recomp: " << blocks.size() << " blocks from " << argv[1]
+            << "\n";
+  return output ? EXIT_SUCCESS : EXIT_FAILURE;
+}
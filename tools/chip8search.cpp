@@ -0,0 +1,128 @@
+// chip8search: search for keypad input sequences that maximise a score
+// read from the machine, e.g. to find how to survive longest.
+//
+// Usage: chip8search <ROM> --probe <Where>[*Weight]... [Options]
+//   --probe <Where>         Score term: a memory address (0x2F0) or a
+//                           register (V3), times an optional weight
+//   --keys <Digits>         Keys to try, as hex digits (default 0-F); not
+//                           pressing anything is always an option
+//   --depth <D>             Moves per sequence (default 10)
+//   --frames <F>            Frames each move is held (default 10)
+//   --cycles-per-frame <C>  Instructions per frame (default 10)
+//   --beam <B>              Candidates kept per depth (default 16)
+//   --threads <T>           Worker threads (default: every core)
+//   --variant <Name>        chip8, schip or xochip quirks
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "search.hpp"
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0]
+              << " <ROM> --probe <Where>[*Weight]... [Options]\n";
+    return EXIT_FAILURE;
+  }
+
+  char const* romFilename = argv[1];
+  SearchOptions options;
+  options.depth = 10;
+  options.framesPerMove = 10;
+  options.threads = std::max(1u, std::thread::hardware_concurrency());
+  unsigned int cyclesPerFrame = 10;
+  std::string keys = "0123456789ABCDEF";
+  std::vector<Probe> probes;
+  Variant variant = VariantFromFilename(romFilename);
+
+  for (int i = 2; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+
+    if (std::strcmp(argv[i], "--probe") == 0 && hasValue) {
+      Probe probe;
+      if (!Probe::Parse(argv[++i], probe)) {
+        std::cerr << "Bad probe: " << argv[i] << "\n";
+        return EXIT_FAILURE;
+      }
+      probes.push_back(probe);
+    } else if (std::strcmp(argv[i], "--keys") == 0 && hasValue) {
+      keys = argv[++i];
+    } else if (std::strcmp(argv[i], "--depth") == 0 && hasValue) {
+      options.depth = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--frames") == 0 && hasValue) {
+      options.framesPerMove = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--cycles-per-frame") == 0 && hasValue) {
+      cyclesPerFrame = std::max(1ul, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--beam") == 0 && hasValue) {
+      options.beamWidth = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+      options.threads = std::max(1ul, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--variant") == 0 && hasValue) {
+      if (!ParseVariant(argv[++i], variant)) {
+        std::cerr << "Unknown variant: " << argv[i] << "\n";
+        return EXIT_FAILURE;
+      }
+    } else {
+      std::cerr << "Unknown option: " << argv[i] << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (probes.empty()) {
+    std::cerr << "Nothing to score, give at least one --probe\n";
+    return EXIT_FAILURE;
+  }
+
+  options.actions.push_back(0);
+  for (char digit : keys) {
+    char text[2] = {digit, '\0'};
+    char* end;
+    unsigned long key = std::strtoul(text, &end, 16);
+    if (*end != '\0') {
+      std::cerr << "Bad key: " << digit << "\n";
+      return EXIT_FAILURE;
+    }
+    options.actions.push_back(1u << key);
+  }
+
+  Chip8 root;
+  root.LoadROM(romFilename);
+  root.SetVariant(variant);
+  root.SetCyclesPerFrame(cyclesPerFrame);
+  root.Seed(0);
+
+  BeamSearch search(root, options, [&probes](Chip8 const& chip8) {
+    return ScoreProbes(probes, chip8);
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  SearchResult result = search.Run();
+  double elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  std::printf("Best score %g after %zu moves:", result.score,
+              result.moves.size());
+  for (uint16_t move : result.moves) {
+    if (move == 0) {
+      std::printf(" -");
+    }
+    for (unsigned int key = 0; key < KEY_COUNT; key++) {
+      if (move & (1u << key)) {
+        std::printf(" %X", key);
+      }
+    }
+  }
+  std::printf("\n");
+
+  std::printf("%lu nodes in %.2f s (%.0f nodes/s, %u threads)\n", result.nodes,
+              elapsed, result.nodes / elapsed, options.threads);
+  std::printf("Snapshots kept: %zu KiB, %zu KiB as full copies\n",
+              result.ownBytes / 1024, result.fullCopyBytes / 1024);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,291 @@
+// chip8stress: generate CHIP-8 programs that hammer one part of the
+// interpreter, for benchmarking engine changes on the workload they target.
+//
+// Usage: chip8stress <Workload> <Output.ch8> [Options]
+//        chip8stress all <Directory> [Options]
+//   --size <N>        Work per loop iteration (default: see below)
+//   --seed <S>        Seed for the random operands (default 1)
+//   --bench <Cycles>  Then run each written ROM for that many instructions
+//                     and print instructions per second
+//
+// Every program is a single endless loop, so any cycle count works.
+//
+// Workloads (default N):
+//   alu      N random 8xy0-8xyE and 7xkk instructions (256)
+//   calls    N nested 2nnn calls, each returning with 00EE, N <= 16 (16)
+//   sprites  N Dxyn draws of 1-15 row sprites across the right and bottom
+//            edges (64)
+//   memory   N Fx65/Fx55 pairs moving 1-16 registers each (64)
+//   selfmod  N instructions rewritten by Fx55 right before they run (64)
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+
+const uint16_t START_ADDRESS = 0x200;
+
+// Instructions are appended in order. Operands that point at something not
+// emitted yet (data, later functions) are recorded with Fixup() and filled
+// in with Patch() once the target address is known.
+class Program {
+ public:
+  uint16_t Here() const { return START_ADDRESS + bytes.size(); }
+
+  void Emit(uint16_t opcode) {
+    bytes.push_back(opcode >> 8u);
+    bytes.push_back(opcode & 0xFFu);
+  }
+
+  void Byte(uint8_t value) { bytes.push_back(value); }
+
+  // Emit "opcode" with an nnn to be patched, and return where it is.
+  size_t Fixup(uint16_t opcode) {
+    Emit(opcode);
+    return bytes.size() - 2;
+  }
+
+  void Patch(size_t at, uint16_t address) {
+    bytes[at] = (bytes[at] & 0xF0u) | (address >> 8u);
+    bytes[at + 1] = address & 0xFFu;
+  }
+
+  bool Fits() const { return bytes.size() <= MEM_SIZE - START_ADDRESS; }
+
+  std::vector<uint8_t> bytes;
+};
+
+typedef std::mt19937 Random;
+
+static unsigned int Pick(Random& random, unsigned int low, unsigned int high) {
+  return std::uniform_int_distribution<unsigned int>(low, high)(random);
+}
+
+static uint16_t Op(unsigned int op, unsigned int x, unsigned int y,
+                   unsigned int n) {
+  return (op << 12u) | (x << 8u) | (y << 4u) | n;
+}
+
+static void GenerateAlu(Program& program, Random& random, unsigned int size) {
+  // VF is the flag register, which most of these overwrite anyway.
+  for (unsigned int x = 0; x < 0xF; x++) {
+    program.Emit(Op(0x6, x, 0, 0) | Pick(random, 0, 0xFF));
+  }
+
+  static const uint8_t KINDS[] = {0x0, 0x1, 0x2, 0x3, 0x4,
+                                  0x5, 0x6, 0x7, 0xE};
+  uint16_t loop = program.Here();
+  for (unsigned int i = 0; i < size; i++) {
+    unsigned int x = Pick(random, 0, 0xE);
+    unsigned int kind = Pick(random, 0, sizeof(KINDS));
+    if (kind == sizeof(KINDS)) {
+      program.Emit(Op(0x7, x, 0, 0) | Pick(random, 1, 0xFF));
+    } else {
+      program.Emit(Op(0x8, x, Pick(random, 0, 0xE), KINDS[kind]));
+    }
+  }
+  program.Emit(0x1000u | loop);
+}
+
+static void GenerateCalls(Program& program, Random&, unsigned int size) {
+  size = std::min(std::max(size, 1u), STACK_LEVELS);
+
+  uint16_t loop = program.Here();
+  size_t call = program.Fixup(0x2000u);
+  program.Emit(0x1000u | loop);
+
+  // Function i counts in V0 and calls function i + 1.
+  for (unsigned int i = 0; i < size; i++) {
+    program.Patch(call, program.Here());
+    program.Emit(0x7001u);
+    if (i + 1 < size) {
+      call = program.Fixup(0x2000u);
+    }
+    program.Emit(0x00EEu);
+  }
+}
+
+static void GenerateSprites(Program& program, Random& random,
+                            unsigned int size) {
+  std::vector<size_t> pointers;
+
+  uint16_t loop = program.Here();
+  for (unsigned int i = 0; i < size; i++) {
+    program.Emit(Op(0x6, 0, 0, 0) | Pick(random, PX_WIDTH - 8, PX_WIDTH - 1));
+    program.Emit(Op(0x6, 1, 0, 0) |
+                 Pick(random, PX_HEIGHT - 15, PX_HEIGHT - 1));
+    pointers.push_back(program.Fixup(0xA000u));
+    program.Emit(Op(0xD, 0, 1, Pick(random, 1, 15)));
+  }
+  program.Emit(0x1000u | loop);
+
+  uint16_t sprite = program.Here();
+  for (unsigned int row = 0; row < 15; row++) {
+    program.Byte(Pick(random, 1, 0xFF));
+  }
+  for (size_t at : pointers) {
+    program.Patch(at, sprite);
+  }
+}
+
+static void GenerateMemory(Program& program, Random& random,
+                           unsigned int size) {
+  const unsigned int BUFFER_SIZE = 256;
+  std::vector<std::pair<size_t, uint16_t>> pointers;
+
+  uint16_t loop = program.Here();
+  for (unsigned int i = 0; i < size; i++) {
+    unsigned int x = Pick(random, 0, 0xF);
+    pointers.push_back(
+        {program.Fixup(0xA000u), Pick(random, 0, BUFFER_SIZE - 16)});
+    program.Emit(Op(0xF, x, 0x6, 0x5));
+    pointers.push_back(
+        {program.Fixup(0xA000u), Pick(random, 0, BUFFER_SIZE - 16)});
+    program.Emit(Op(0xF, x, 0x5, 0x5));
+  }
+  program.Emit(0x1000u | loop);
+
+  uint16_t buffer = program.Here();
+  for (unsigned int i = 0; i < BUFFER_SIZE; i++) {
+    program.Byte(Pick(random, 0, 0xFF));
+  }
+  for (auto const& [at, offset] : pointers) {
+    program.Patch(at, buffer + offset);
+  }
+}
+
+static void GenerateSelfModifying(Program& program, Random&,
+                                  unsigned int size) {
+  // V0:V1 is the instruction written over each site: 72kk (V2 += kk),
+  // with kk = V1 counting up, so the code changes on every pass.
+  program.Emit(0x6072u);
+
+  uint16_t loop = program.Here();
+  for (unsigned int i = 0; i < size; i++) {
+    program.Emit(0xA000u | (program.Here() + 4));
+    program.Emit(0xF155u);
+    program.Emit(0x7200u);
+  }
+  program.Emit(0x7101u);
+  program.Emit(0x1000u | loop);
+}
+
+struct Workload {
+  char const* name;
+  void (*generate)(Program& program, Random& random, unsigned int size);
+  unsigned int defaultSize;
+};
+
+static const Workload WORKLOADS[] = {
+    {"alu", GenerateAlu, 256},
+    {"calls", GenerateCalls, 16},
+    {"sprites", GenerateSprites, 64},
+    {"memory", GenerateMemory, 64},
+    {"selfmod", GenerateSelfModifying, 64},
+};
+
+static bool Write(Workload const& workload, std::string const& filename,
+                  unsigned int size, uint32_t seed) {
+  Random random(seed);
+  Program program;
+  workload.generate(program, random, size ? size : workload.defaultSize);
+
+  if (!program.Fits()) {
+    std::cerr << workload.name << ": " << program.bytes.size()
+              << " bytes doesn't fit in memory, use a smaller --size\n";
+    return false;
+  }
+
+  std::ofstream file(filename, std::ios::binary);
+  file.write(reinterpret_cast<char const*>(program.bytes.data()),
+             program.bytes.size());
+  if (!file) {
+    std::cerr << "Can't write " << filename << "\n";
+    return false;
+  }
+  std::printf("%-8s %5zu bytes  %s\n", workload.name, program.bytes.size(),
+              filename.c_str());
+  return true;
+}
+
+static void Bench(Workload const& workload, std::string const& filename,
+                  unsigned long cycles) {
+  Chip8 chip8;
+  chip8.LoadROM(filename.c_str());
+  chip8.Seed(0);
+
+  auto start = std::chrono::steady_clock::now();
+  chip8.RunCycles(cycles);
+  double elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  std::printf("%-8s %12.0f instructions/s\n", workload.name,
+              cycles / elapsed);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    std::cerr << "Usage: " << argv[0]
+              << " <alu|calls|sprites|memory|selfmod|all> <Output>"
+                 " [--size N] [--seed S] [--bench Cycles]\n";
+    return EXIT_FAILURE;
+  }
+
+  std::string which = argv[1];
+  std::string output = argv[2];
+  unsigned int size = 0;
+  uint32_t seed = 1;
+  unsigned long benchCycles = 0;
+
+  for (int i = 3; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+
+    if (std::strcmp(argv[i], "--size") == 0 && hasValue) {
+      size = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) {
+      seed = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--bench") == 0 && hasValue) {
+      benchCycles = std::stoul(argv[++i]);
+    } else {
+      std::cerr << "Unknown option: " << argv[i] << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::vector<std::pair<Workload const*, std::string>> written;
+  for (Workload const& workload : WORKLOADS) {
+    if (which == "all") {
+      std::filesystem::create_directories(output);
+      written.push_back(
+          {&workload, output + "/" + workload.name + ".ch8"});
+    } else if (which == workload.name) {
+      written.push_back({&workload, output});
+    }
+  }
+
+  if (written.empty()) {
+    std::cerr << "Unknown workload: " << which << "\n";
+    return EXIT_FAILURE;
+  }
+
+  for (auto const& [workload, filename] : written) {
+    if (!Write(*workload, filename, size, seed)) {
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (benchCycles) {
+    for (auto const& [workload, filename] : written) {
+      Bench(*workload, filename, benchCycles);
+    }
+  }
+  return EXIT_SUCCESS;
+}
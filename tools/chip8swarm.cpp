@@ -0,0 +1,181 @@
+// chip8swarm: run many copies of one ROM on a single thread through the
+// coroutine scheduler, and report how much of the work parking saved.
+//
+// Usage: chip8swarm <ROM> [Options]
+//   --machines <N>  Copies to run (default 1000)
+//   --frames <N>    60 Hz frames to run (default 600)
+//   --ips <N>       Instructions per second per machine (default: the
+//                   variant's recommended speed)
+//   --presses <N>   Random key presses per frame, each on a random machine
+//                   and released the frame after (default 1)
+//   --variant <Name>  chip8, schip or xochip (default from the extension)
+//   --spin          Drive every machine every frame with RunCycles()
+//                   instead, for comparison
+//   --faults <Policy>  ignore, trap or halt (default ignore); halted
+//                   machines drop out of the schedule
+//
+// Every machine gets its own random seed, so they drift apart.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "chip8.hpp"
+#include "library.hpp"
+#include "scheduler.hpp"
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " <ROM> [Options]\n"
+              << "  --machines <N>    Copies to run (default 1000)\n"
+              << "  --frames <N>      60 Hz frames to run (default 600)\n"
+              << "  --ips <N>         Instructions per second per machine\n"
+              << "  --presses <N>     Random key presses per frame (default 1)\n"
+              << "  --variant <Name>  chip8, schip or xochip\n"
+              << "  --spin            Run every machine every frame instead\n"
+              << "  --faults <Policy> ignore, trap or halt\n";
+    return EXIT_FAILURE;
+  }
+
+  char const* romFilename = argv[1];
+  unsigned long machineCount = 1000;
+  unsigned long frames = 600;
+  unsigned long ips = 0;
+  unsigned long presses = 1;
+  Variant variant = VariantFromFilename(romFilename);
+  bool spin = false;
+  FaultPolicy faultPolicy = FaultPolicy::IGNORE;
+
+  for (int i = 2; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+
+    if (std::strcmp(argv[i], "--machines") == 0 && hasValue) {
+      machineCount = std::max(1ul, std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--frames") == 0 && hasValue) {
+      frames = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--ips") == 0 && hasValue) {
+      ips = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--presses") == 0 && hasValue) {
+      presses = std::stoul(argv[++i]);
+    } else if (std::strcmp(argv[i], "--variant") == 0 && hasValue) {
+      if (!ParseVariant(argv[++i], variant)) {
+        std::cerr << "Unknown variant: " << argv[i] << "\n";
+        return EXIT_FAILURE;
+      }
+    } else if (std::strcmp(argv[i], "--spin") == 0) {
+      spin = true;
+    } else if (std::strcmp(argv[i], "--faults") == 0 && hasValue) {
+      if (!ParseFaultPolicy(argv[++i], faultPolicy)) {
+        std::cerr << "Unknown fault policy: " << argv[i] << "\n";
+        return EXIT_FAILURE;
+      }
+    } else {
+      std::cerr << "Unknown option: " << argv[i] << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (ips == 0) {
+    ips = RecommendedIps(variant);
+  }
+  unsigned int cyclesPerFrame = std::max(1ul, ips / 60);
+
+  // Chip8 is large and must not move once a task points at it.
+  std::vector<std::unique_ptr<Chip8>> machines;
+  for (unsigned long i = 0; i < machineCount; i++) {
+    auto chip8 = std::make_unique<Chip8>();
+    chip8->LoadROM(romFilename);
+    chip8->SetVariant(variant);
+    chip8->Seed(static_cast<uint32_t>(i + 1));
+    chip8->SetFaultPolicy(faultPolicy);
+    machines.push_back(std::move(chip8));
+  }
+
+  Scheduler scheduler;
+  if (!spin) {
+    for (auto& chip8 : machines) {
+      scheduler.Spawn(*chip8, RunMachine(scheduler, *chip8, cyclesPerFrame));
+    }
+  } else {
+    for (auto& chip8 : machines) {
+      chip8->SetExternalTimers(true);
+    }
+  }
+
+  std::mt19937 random(12345);
+  std::uniform_int_distribution<unsigned long> pickMachine(0,
+                                                           machineCount - 1);
+  std::uniform_int_distribution<unsigned int> pickKey(0, KEY_COUNT - 1);
+  std::vector<std::pair<unsigned long, uint8_t>> held;
+
+  uint64_t resumed = 0;
+  auto start = std::chrono::steady_clock::now();
+
+  for (unsigned long frame = 0; frame < frames; frame++) {
+    for (auto [machine, key] : held) {
+      if (spin) {
+        machines[machine]->SetKey(key, false);
+      } else {
+        scheduler.SetKey(static_cast<Scheduler::MachineId>(machine), key,
+                         false);
+      }
+    }
+    held.clear();
+
+    for (unsigned long i = 0; i < presses; i++) {
+      unsigned long machine = pickMachine(random);
+      uint8_t key = static_cast<uint8_t>(pickKey(random));
+      if (spin) {
+        machines[machine]->SetKey(key, true);
+      } else {
+        scheduler.SetKey(static_cast<Scheduler::MachineId>(machine), key,
+                         true);
+      }
+      held.emplace_back(machine, key);
+    }
+
+    if (spin) {
+      for (auto& chip8 : machines) {
+        chip8->RunCycles(cyclesPerFrame);
+        chip8->TickTimers();
+      }
+      resumed += machineCount;
+    } else {
+      resumed += scheduler.RunFrame();
+    }
+  }
+
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  double machineFrames = static_cast<double>(machineCount) * frames;
+
+  std::printf("%lu machines x %lu frames at %u instructions/frame in %.3f s\n",
+              machineCount, frames, cyclesPerFrame, seconds);
+  std::printf("%.0f machine-frames/s (%.1fx real time per machine)\n",
+              machineFrames / seconds,
+              machineFrames / seconds / 60.0 / machineCount);
+  std::printf("%.1f%% of machine-frames run, %zu machines waiting for keys\n",
+              machineFrames > 0 ? 100.0 * resumed / machineFrames : 0.0,
+              spin ? 0 : scheduler.WaitingForKeys());
+
+  unsigned long faulted = 0;
+  unsigned long halted = 0;
+  for (auto const& chip8 : machines) {
+    faulted += chip8->FaultCount() > 0;
+    halted += chip8->Halted();
+  }
+  if (faulted > 0) {
+    std::printf("%lu machines faulted, %lu halted\n", faulted, halted);
+  }
+
+  return 0;
+}